@@ -2,6 +2,7 @@
 #define __FP_H_
 
 #include "birch.h"
+#include "Math.h"
 
 template<typename R, typename S>
 class Fp
@@ -20,7 +21,7 @@ public:
             this->kp = (((R)-1)/p)*p;
             this->kp_inv = ((S)-1)/kp;
             this->use_inverse_lut = use_inverse_lut;
-            if (use_inverse_lut) this->make_inverse_lut();
+            if (use_inverse_lut) this->inverse_lut = this->shared_inverse_lut();
         }
     }
 
@@ -34,6 +35,11 @@ public:
         return (value < 0) ? (R)(value+this->p) : (R)value;
     }
 
+    inline R mod(const SmallZ& a) const
+    {
+        return a.is_small() ? this->mod(a.get_si()) : this->mod(a.get_z());
+    }
+
     template<typename T>
     inline Vector3<R> mod(const Vector3<T>& vec) const
     {
@@ -44,12 +50,12 @@ public:
         return res;
     }
 
-    inline virtual R neg(R a) const
+    inline R neg(R a) const
     {
         return this->kp-a;
     }
 
-    inline virtual R mul(R a, R b) const
+    inline R mul(R a, R b) const
     {
         S rem = ((S)a)*b;
         R hi = rem >> bits;
@@ -66,18 +72,18 @@ public:
         return rem;
     }
 
-    inline virtual R add(R a, R b) const
+    inline R add(R a, R b) const
     {
         R neg = this->kp-a;
         return (b >= neg) ? b-neg : this->kp-(neg-b);
     }
 
-    inline virtual R sub(R a, R b) const
+    inline R sub(R a, R b) const
     {
         return add(a, this->kp-b);
     }
 
-    inline virtual R pow(R a, Z64 e) const
+    inline R pow(R a, Z64 e) const
     {
         if (e == 0) return 1;
         if (e == 1) return a;
@@ -89,12 +95,10 @@ public:
 
     inline int legendre(R a) const
     {
-        Z aa(a);
-        Z pp(p);
-        return mpz_legendre(aa.get_mpz_t(), pp.get_mpz_t());
+        return Math<R>::jacobi(a, this->p);
     }
 
-    inline virtual R sqrt(R a) const
+    inline R sqrt(R a) const
     {
         a = a % p;
         if (a == 1) return 1;
@@ -144,24 +148,72 @@ public:
         return 0;
     }
 
-    inline virtual R inverse(R a) const
+    inline R inverse(R a) const
     {
-        if (this->use_inverse_lut) return this->inverse_lut[a];
+        if (this->use_inverse_lut) return (*this->inverse_lut)[a];
         else return this->inv(a);
     }
 
-    inline virtual R inverse(const Z& a) const
+    inline R inverse(const Z& a) const
     {
         R inv = mpz_get_ui(a.get_mpz_t());
         return this->inverse(inv);
     }
 
-    inline virtual R inverse(const Z64& a) const
+    inline R inverse(const Z64& a) const
     {
         R inv = (R)a;
         return this->inverse(inv);
     }
 
+    inline R inverse(const SmallZ& a) const
+    {
+        R inv = (R)a.get_si();
+        return this->inverse(inv);
+    }
+
+    // Inverts the n elements of a and stores the results in res, which must
+    // not alias a. Without the lookup table this uses Montgomery's trick, so
+    // that only one inversion is performed for the whole array. As with
+    // inverse, zero is mapped to zero.
+    void inverse(const R *a, R *res, size_t n) const
+    {
+        if (this->use_inverse_lut)
+        {
+            const std::vector<R>& lut = *this->inverse_lut;
+            for (size_t k=0; k<n; k++) res[k] = lut[a[k]];
+            return;
+        }
+
+        // Store the partial products of the nonzero elements...
+        R prod = 1;
+        for (size_t k=0; k<n; k++)
+        {
+            res[k] = prod;
+            if (a[k] != 0) prod = this->mul(prod, a[k]);
+        }
+
+        // ...invert their product...
+        R inv = this->inv(this->mod(prod));
+
+        // ...and then peel off the inverses one at a time.
+        for (size_t k=n; k-->0; )
+        {
+            if (a[k] == 0)
+            {
+                res[k] = 0;
+                continue;
+            }
+
+            res[k] = this->mod(this->mul(inv, res[k]));
+            inv = this->mul(inv, a[k]);
+
+            #ifdef DEBUG
+            assert( ((S)a[k] * (S)res[k]) % p == 1 );
+            #endif
+        }
+    }
+
     inline R random(void) const
     {
         return (R)(*this->distr)(*this->rng);
@@ -173,19 +225,22 @@ private:
     R kp_inv;
     static constexpr int bits = 8 * sizeof(R);
     bool use_inverse_lut;
-    std::vector<R> inverse_lut;
+    std::shared_ptr<const std::vector<R>> inverse_lut;
+
+    // The number of bytes of inverse lookup tables which are kept in the
+    // process-wide cache. Tables are cached in the order in which they are
+    // first requested, and once the budget is used up the tables for further
+    // primes are built for each field without being cached.
+    static constexpr size_t inverse_lut_cache_bytes = 1 << 26;
 
     // Random number generator.
     std::unique_ptr<std::mt19937> rng;
     std::unique_ptr<std::uniform_int_distribution<>> distr;
 
-    inline virtual R inv(R a) const
+    inline R inv(R a) const
     {
         if (a == 0) return 0;
-        Z aa(a);
-        Z pp(p);
-        mpz_invert(aa.get_mpz_t(), aa.get_mpz_t(), pp.get_mpz_t());
-        R ainv = mpz_get_ui(aa.get_mpz_t());
+        R ainv = Math<R>::inverse(a, this->p);
 
         #ifdef DEBUG
         assert( ((S)a * (S)ainv) % p == 1 );
@@ -194,38 +249,38 @@ private:
         return ainv;
     }
 
-    void inverse_lut_populate(Z32 offset, Z32 len)
+    void inverse_lut_populate(std::vector<R>& lut, Z32 offset, Z32 len) const
     {
         Z32 datalen = len<<1;
 
         // Set the initial values.
-        std::iota(this->inverse_lut.begin()+offset,
-            this->inverse_lut.begin()+offset+len, offset);
+        std::iota(lut.begin()+offset,
+            lut.begin()+offset+len, offset);
 
         // Multipley up to the root node...
         for (Z32 i=0, j=len; i<j; i+=2, j++)
         {
-            R a = this->inverse_lut[offset+i];
-            R b = this->inverse_lut[offset+i+1];
-            this->inverse_lut[offset+j] = this->mul(a, b);
+            R a = lut[offset+i];
+            R b = lut[offset+i+1];
+            lut[offset+j] = this->mul(a, b);
         }
 
         // ...invert the root node...
-        R ainv = this->inv(this->inverse_lut[offset+datalen-2]);
-        this->inverse_lut[offset+datalen-2] = ainv;
+        R ainv = this->inv(lut[offset+datalen-2]);
+        lut[offset+datalen-2] = ainv;
 
         // ...and then backtrack to the inverse.
         for (Z32 i=datalen-4, j=datalen-2; i>=0; i-=2, --j)
         {
-            R temp = this->inverse_lut[offset+i];
-            R a = this->inverse_lut[offset+i+1];
-            R b = this->inverse_lut[offset+j];
-            this->inverse_lut[offset+i] = this->mul(a, b);
-            this->inverse_lut[offset+i+1] = this->mul(temp, b);
+            R temp = lut[offset+i];
+            R a = lut[offset+i+1];
+            R b = lut[offset+j];
+            lut[offset+i] = this->mul(a, b);
+            lut[offset+i+1] = this->mul(temp, b);
         }
     }
 
-    void make_inverse_lut(void)
+    void make_inverse_lut(std::vector<R>& lut) const
     {
         // TODO: The following could probably be replaced with clz.
         Z32 len = 1;
@@ -237,13 +292,13 @@ private:
         }
 
         // Make enough room in the lut to grow the tree.
-        inverse_lut.resize(1+(len<<1));
+        lut.resize(1+(len<<1));
 
         Z32 offset = 1;
         q = p;
         while (q > 1)
         {
-            this->inverse_lut_populate(offset, len);
+            this->inverse_lut_populate(lut, offset, len);
 
             offset |= len;
             q ^= len;
@@ -258,66 +313,111 @@ private:
         }
 
         // Shrink the lut to the appropriate size.
-        this->inverse_lut.resize(p);
+        lut.resize(p);
 
         #ifdef DEBUG
         for (Z32 i=1; i<p; i++)
         {
-            assert( this->mul(i, this->inverse_lut[i]) % p == 1 );
+            assert( this->mul(i, lut[i]) % p == 1 );
         }
         #endif
     }
+
+    // Returns the inverse lookup table for this prime, which is shared by all
+    // fields over the same prime. The tables are never modified once they
+    // are built, so they may be used from several threads at once.
+    std::shared_ptr<const std::vector<R>> shared_inverse_lut(void) const
+    {
+        static std::mutex mutex;
+        static std::map<R, std::shared_ptr<const std::vector<R>>> cache;
+        static size_t cache_bytes = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(this->p);
+            if (it != cache.end()) return it->second;
+        }
+
+        // Build the table without holding the lock, so that other primes
+        // can be looked up in the meantime.
+        std::shared_ptr<std::vector<R>> lut = std::make_shared<std::vector<R>>();
+        this->make_inverse_lut(*lut);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t bytes = lut->size() * sizeof(R);
+        if (cache_bytes + bytes <= inverse_lut_cache_bytes)
+        {
+            // If another thread has built the same table in the meantime,
+            // emplace keeps the existing one.
+            auto res = cache.emplace(this->p, lut);
+            if (res.second) cache_bytes += bytes;
+            return res.first->second;
+        }
+        return lut;
+    }
 };
 
+// The field with two elements. This is a separate field type rather than an
+// override of Fp, so that code instantiated on it can inline its arithmetic.
 template<typename R, typename S>
-class F2 : public Fp<R,S>
+class F2 : private Fp<R,S>
 {
 public:
-    F2(const R& p, W64 seed) : Fp<R,S>(p, seed, false) {}
+    F2(const R& p, W64 seed, bool use_inverse_lut=false) : Fp<R,S>(p, seed, false) {}
 
-    inline R mul(R a, R b) const override
+    using Fp<R,S>::prime;
+    using Fp<R,S>::mod;
+    using Fp<R,S>::legendre;
+    using Fp<R,S>::random;
+
+    inline R mul(R a, R b) const
     {
         return ((a & b) & 1);
     }
 
-    inline R add(R a, R b) const override
+    inline R add(R a, R b) const
     {
         return ((a ^ b) & 1);
     }
 
-    inline R sub(R a, R b) const override
+    inline R sub(R a, R b) const
     {
         return ((a ^ b) & 1);
     }
 
-    inline R pow(R a, Z64 e) const override
+    inline R pow(R a, Z64 e) const
     {
         return e == 0 ? 1 : (a & 1);
     }
 
-    inline R sqrt(R a) const override
+    inline R sqrt(R a) const
     {
         return (a & 1);
     }
 
-    inline R inverse(R a) const override
+    inline R inverse(R a) const
     {
         return (a & 1);
     }
 
-    inline R inverse(const Z& a) const override
+    inline R inverse(const Z& a) const
     {
         return (mpz_get_ui(a.get_mpz_t()) & 1);
     }
 
-    inline R inverse(const Z64& a) const override
+    inline R inverse(const Z64& a) const
     {
         return (a & 1);
     }
-private:
-    inline R inv(R a) const override
+
+    inline R inverse(const SmallZ& a) const
     {
-        return (a & 1);
+        return (a.get_si() & 1);
+    }
+
+    void inverse(const R *a, R *res, size_t n) const
+    {
+        for (size_t k=0; k<n; k++) res[k] = (a[k] & 1);
     }
 };
 
@@ -8,7 +8,10 @@
 #include "Isometry.h"
 #include "NeighborManager.h"
 #include "Eigenvector.h"
+#include <queue>
 
+// A genus representative together with the isometries to and from the
+// mother form. The genus itself stores these fields in separate arrays.
 template<typename R>
 class GenusRep
 {
@@ -22,7 +25,6 @@ public:
     Isometry<R> sinv;
     Z64 parent;
     R p;
-    std::map<R,int> es;
 };
 
 template<typename R>
@@ -31,6 +33,8 @@ class Genus
     template<typename T>
     friend class Genus;
 
+    friend class PrecisionPlanner<R>;
+
 public:
     Genus() = default;
 
@@ -77,11 +81,6 @@ public:
             this->conductors.push_back(value);
         }
 
-        GenusRep<R> rep;
-        rep.q = q;
-        rep.p = 1;
-        rep.parent = -1;
-
         // Set the mass as a multiple of 24, as this is the largest integer
         // that can appear in its denominator. This value is used to determine
         // when the genus has been fully populated.
@@ -91,9 +90,12 @@ public:
         // since most isometry classes typically have trivial automorphism
         // group.
         Z64 estimated_size = ceil(mpz_get_d(this->mass_x24.get_mpz_t()) / 24.0);
-        auto *ptr = new HashMap<GenusRep<R>>(estimated_size);
-        this->hash = std::unique_ptr<HashMap<GenusRep<R>>>(ptr);
-        this->hash->add(rep);
+        auto *ptr = new HashMap<QuadForm<R>>(estimated_size);
+        this->hash = std::unique_ptr<HashMap<QuadForm<R>>>(ptr);
+        this->hash->add(q);
+        this->rep_isometries.emplace_back();
+        this->rep_parents.push_back(-1);
+        this->rep_primes.push_back(1);
 
         // The spinor primes hash table, used to identify the primes used in
         // constructing the genus representatives.
@@ -105,10 +107,6 @@ public:
         Z p = 1;
         W16 prime = 1;
 
-        // A temporary placeholder for the genus representatives before they
-        // are fully built.
-        GenusRep<R> foo;
-
         bool done = (sum_mass_x24 == this->mass_x24);
         while (!done)
         {
@@ -119,130 +117,76 @@ public:
                 prime = mpz_get_ui(p.get_mpz_t());
             }
             while (this->disc % prime == 0);
-            std::shared_ptr<W16_Fp> GF;
+
             if (prime == 2)
-                GF = std::make_shared<W16_F2>(prime, this->seed_);
+            {
+                std::shared_ptr<W16_F2> GF = std::make_shared<W16_F2>(prime, this->seed_);
+                done = this->add_neighbors(GF, sum_mass_x24);
+            }
             else
-                GF = std::make_shared<W16_Fp>(prime, this->seed_, true);
-
-            size_t current = 0;
-            while (!done && current < this->hash->size())
             {
-                // Get the current quadratic form and build the neighbor manager.
-                const QuadForm<R>& mother = this->hash->get(current).q;
-                NeighborManager<W16,W32,R> manager(mother, GF);
-
-                #ifdef DEBUG
-                // Build the affine quadratic form for debugging purposes.
-                W16_QuadForm qp = mother.mod(GF);
-                #endif
-
-                for (W16 t=0; !done && t<=prime; t++)
-                {
-                    #ifdef DEBUG
-                    // Verify that the appropriate vector is isotropic.
-                    W16_Vector3 vec = manager.isotropic_vector(t);
-                    assert( qp.evaluate(vec) % prime == 0 );
-                    #endif
-
-                    // Construct the neighbor, the isometry is stored in s.
-                    foo.s.set_identity();
-                    foo.q = manager.get_neighbor(t, foo.s);
-
-                    #ifdef DEBUG
-                    // Verify neighbor discriminant matches.
-                    assert( rep.q.discriminant() == mother.discriminant() );
-                    #endif
-
-                    // Reduce the neighbor to its Eisenstein form and add it to
-                    // the hash table.
-                    foo.q = QuadForm<R>::reduce(foo.q, foo.s);
-                    foo.p = prime;
-                    foo.parent = current;
-
-                    bool added = this->hash->add(foo);
-                    if (added)
-                    {
-                        const GenusRep<R>& temp = this->hash->last();
-                        sum_mass_x24 += 48 / QuadForm<R>::num_automorphisms(temp.q);
-                        done = (sum_mass_x24 == this->mass_x24);
-                        this->spinor_primes->add(prime);
-                    }
-                }
-
-                ++current;
+                std::shared_ptr<W16_Fp> GF = std::make_shared<W16_Fp>(prime, this->seed_, true);
+                done = this->add_neighbors(GF, sum_mass_x24);
             }
         }
 
-        // Initialize the dimensions to zero, we will compute these values below.
-        this->dims.resize(num_conductors, 0);
+        // The genus is complete, so its table of representatives will not
+        // change anymore.
+        this->hash->freeze();
 
-        // Create the lookup table values for each genus rep at each conductor.
         size_t genus_size = this->hash->size();
-        this->lut_positions.resize(num_conductors, std::vector<int>(genus_size, -1));
-        this->num_auts.resize(num_conductors);
+
+        // Move each representative onto a path of smallest scalar from the
+        // mother form, which keeps the composite isometries small.
+        std::vector<size_t> order = this->shortest_paths();
 
         // The genus rep isometries were initialized only to contain the
         // isometry between the parent and its child, we now want to update
         // these isometries so that they are rational isometries between the
-        // "mother" quadratic form and the genus rep.
-        for (size_t n=0; n<this->hash->size(); n++)
+        // "mother" quadratic form and the genus rep. Parents precede their
+        // children in order.
+        this->rep_inverses.resize(genus_size);
+        this->rep_scalars.resize(genus_size, 1);
+        for (size_t n : order)
         {
-            GenusRep<R>& rep = this->hash->at(n);
-
             // Only compute composite isometries if we are not considering the
             // mother form.
             if (n)
             {
-                GenusRep<R>& parent = this->hash->at(rep.parent);
+                Z64 parent = this->rep_parents[n];
+                Isometry<R>& s = this->rep_isometries[n];
+                Isometry<R>& sinv = this->rep_inverses[n];
+                const R& p = this->rep_primes[n];
 
                 // Construct the isometries to/from the mother quadratic form.
-                rep.sinv = rep.s.inverse(rep.p);
-                rep.sinv = rep.sinv * parent.sinv;
-                rep.s = parent.s * rep.s;
+                this->check_isometry_precision(s, this->rep_isometries[parent],
+                                               this->rep_inverses[parent]);
+                sinv = s.inverse(p);
+                sinv = sinv * this->rep_inverses[parent];
+                s = this->rep_isometries[parent] * s;
 
-                // Copy the numerators, and increment the genus rep prime.
-                rep.es = parent.es;
-                ++rep.es[rep.p];
+                // The scalar of the isometries is the product of the primes
+                // along the path from the mother form.
+                this->rep_scalars[n] = this->rep_scalars[parent] * p;
 
                 #ifdef DEBUG
-                R scalar = birch_util::my_pow(rep.es);
+                const QuadForm<R>& rep = this->hash->get(n);
+                R scalar = this->rep_scalars[n];
                 scalar *= scalar;
 
                 // Verify that s is an isometry from the mother form to the rep,
                 // and that sinv is an isometry from the rep to the mother form.
-                assert( rep.s.is_isometry(q, rep.q, scalar) );
-                assert( rep.sinv.is_isometry(rep.q, q, scalar) );
+                assert( s.is_isometry(q, rep, scalar) );
+                assert( sinv.is_isometry(rep, q, scalar) );
                 #endif
             }
-
-            // Determine which subspaces this representative contributes.
-            const std::vector<Isometry<R>>& auts = QuadForm<R>::proper_automorphisms(rep.q);
-            std::vector<bool> ignore(this->conductors.size(), false);
-            for (const Isometry<R>& s : auts)
-            {
-                Z64 vals = this->spinor->norm(rep.q, s, 1);
-
-                for (size_t k=0; k<num_conductors; k++)
-                {
-                    if (!ignore[k] && (birch_util::popcnt(vals & k) & 1))
-                    {
-                        ignore[k] = true;
-                    }
-                }
-            }
-
-            int num = QuadForm<R>::num_automorphisms(rep.q);
-            for (size_t k=0; k<num_conductors; k++)
-            {
-                if (!ignore[k])
-                {
-                    this->lut_positions[k][n] = this->dims[k];
-                    this->num_auts[k].push_back(num);
-                }
-                this->dims[k] += (ignore[k] ? 0 : 1);
-            }
         }
+
+        // The subspace data of each conductor is computed on first use.
+        this->dims.assign(num_conductors, 0);
+        this->conductor_classes.assign(num_conductors, std::vector<W16>());
+        this->conductor_ready.assign(num_conductors, false);
+        this->classes_ready = false;
     }
 
     template<typename T>
@@ -263,14 +207,21 @@ public:
             this->conductors.push_back(birch_util::convert_Integer<T,R>(cond));
         }
 
-        // Copy dimensions.
+        // Copy dimensions, as far as they have been computed.
         this->dims = src.dims;
+        this->conductor_ready = src.conductor_ready;
 
         // Copy automorphisms counts.
-        this->num_auts = src.num_auts;
+        this->rep_num_auts = src.rep_num_auts;
 
-        // Copy lookup table dimensions.
-        this->lut_positions = src.lut_positions;
+        // Copy the positions of the representatives in each subspace.
+        this->classes_ready = src.classes_ready;
+        this->aut_classes = src.aut_classes;
+        this->rep_classes = src.rep_classes;
+        this->conductor_classes = src.conductor_classes;
+        this->class_words = src.class_words;
+        this->class_bits = src.class_bits;
+        this->class_ranks = src.class_ranks;
 
         // Copy mass.
         this->mass_x24 = src.mass_x24;
@@ -283,11 +234,28 @@ public:
         }
 
         // Build a copy of the genus representatives hash table.
-        this->hash = std::unique_ptr<HashMap<GenusRep<R>>>(new HashMap<GenusRep<R>>(src.hash->size()));
-        for (const GenusRep<T>& rep : src.hash->keys())
+        this->hash = std::unique_ptr<HashMap<QuadForm<R>>>(new HashMap<QuadForm<R>>(src.hash->size()));
+        for (const QuadForm<T>& rep : src.hash->keys())
+        {
+            this->hash->add(birch_util::convert_QuadForm<T,R>(rep));
+        }
+        this->hash->freeze();
+
+        // Convert the isometries of the genus representatives, along with
+        // their scalars and the paths used to find them.
+        size_t genus_size = src.size();
+        this->rep_isometries.reserve(genus_size);
+        this->rep_inverses.reserve(genus_size);
+        this->rep_scalars.reserve(genus_size);
+        this->rep_primes.reserve(genus_size);
+        for (size_t n=0; n<genus_size; n++)
         {
-            this->hash->add(birch_util::convert_GenusRep<T,R>(rep));
+            this->rep_isometries.push_back(birch_util::convert_Isometry<T,R>(src.rep_isometries[n]));
+            this->rep_inverses.push_back(birch_util::convert_Isometry<T,R>(src.rep_inverses[n]));
+            this->rep_scalars.push_back(birch_util::convert_Integer<T,R>(src.rep_scalars[n]));
+            this->rep_primes.push_back(birch_util::convert_Integer<T,R>(src.rep_primes[n]));
         }
+        this->rep_parents = src.rep_parents;
 
         // Create Spinor class.
         std::vector<R> primes;
@@ -320,6 +288,8 @@ public:
 
     std::map<R,size_t> dimension_map(void) const
     {
+        this->ensure_conductors();
+
         std::map<R,size_t> temp;
         size_t num_conductors = this->conductors.size();
         for (size_t k=0; k<num_conductors; k++)
@@ -329,6 +299,13 @@ public:
         return temp;
     }
 
+    size_t dimension(const R& conductor) const
+    {
+        size_t k = this->conductor_index(conductor);
+        this->ensure_conductor(k);
+        return this->dims[k];
+    }
+
     std::map<R,std::vector<int>> hecke_matrix_dense(const R& p) const
     {
         if (this->disc % p == 0)
@@ -349,23 +326,8 @@ public:
 
     Eigenvector<R> eigenvector(const std::vector<Z32>& vec, const R& conductor) const
     {
-        size_t num_conductors = this->conductors.size();
-        bool found = false;
-
-        size_t k;
-        for (k=0; k<num_conductors; k++)
-        {
-            if (this->conductors[k] == conductor)
-            {
-                found = true;
-                break;
-            }
-        }
-
-        if (!found)
-        {
-            throw std::invalid_argument("Invalid conductor.");
-        }
+        size_t k = this->conductor_index(conductor);
+        this->ensure_conductor(k);
 
         size_t dim = this->dims[k];
         if (dim != vec.size())
@@ -376,13 +338,13 @@ public:
         size_t fulldim = this->size();
 
         std::vector<Z32> temp(this->size());
-        const std::vector<int>& lut = this->lut_positions[k];
 
+        size_t pos = 0;
         for (size_t n=0; n<fulldim; n++)
         {
-            if (lut[n] != -1)
+            if (this->in_conductor(n, k))
             {
-                temp[n] = vec[lut[n]];
+                temp[n] = vec[pos++];
             }
         }
 
@@ -420,81 +382,632 @@ public:
         }
     }
 
-    const GenusRep<R>& representative(size_t n) const
+    GenusRep<R> representative(size_t n) const
+    {
+        GenusRep<R> rep;
+        rep.q = this->hash->get(n);
+        rep.s = this->rep_isometries[n];
+        rep.sinv = this->rep_inverses[n];
+        rep.parent = this->rep_parents[n];
+        rep.p = this->rep_primes[n];
+        return rep;
+    }
+
+    const QuadForm<R>& form(size_t n) const
     {
         return this->hash->get(n);
     }
 
+    // The isometry from the mother form to the n-th representative, its
+    // inverse, and the scalar by which both of them are scaled.
+    const Isometry<R>& isometry(size_t n) const
+    {
+        return this->rep_isometries[n];
+    }
+
+    const Isometry<R>& inverse_isometry(size_t n) const
+    {
+        return this->rep_inverses[n];
+    }
+
+    const R& scalar(size_t n) const
+    {
+        return this->rep_scalars[n];
+    }
+
     size_t indexof(const GenusRep<R>& rep) const
     {
-        return this->hash->indexof(rep);
+        return this->hash->indexof(rep.q);
+    }
+
+    // Finds the classes of n reduced forms at once, overlapping the memory
+    // accesses of the lookups.
+    void indexof_many(const GenusRep<R> *reps, size_t n, size_t *indices) const
+    {
+        this->hash->indexof_many(reps, n, indices,
+            [](const GenusRep<R>& rep) -> const QuadForm<R>& { return rep.q; });
+    }
+
+    const HashMap<QuadForm<R>>& representatives(void) const
+    {
+        return *this->hash;
     }
 
 private:
     R disc;
     std::vector<R> prime_divisors;
     std::vector<R> conductors;
-    std::vector<size_t> dims;
-    std::vector<std::vector<size_t>> num_auts;
-    std::vector<std::vector<int>> lut_positions;
+
+    // The position of a representative in the basis of the subspace of
+    // conductor k is its rank among the representatives in that subspace.
+    // Membership only depends on the class of the representative, that is,
+    // on the spinor norms of its automorphisms, so for each class we keep a
+    // bitmap of its representatives with the ranks at each word, and for
+    // each conductor the classes which contribute to it. This takes memory
+    // linear in the genus size, rather than a table for each conductor.
+    //
+    // All of this is computed on first use and cached, since it needs the
+    // spinor norms of the automorphisms of every representative, and since
+    // usually only a few of the 2^k conductors are of interest.
+    mutable std::vector<size_t> dims;
+    mutable std::vector<bool> conductor_ready;
+    mutable bool classes_ready;
+    mutable std::vector<std::vector<Z64>> aut_classes;
+    mutable std::vector<W16> rep_classes;
+    mutable std::vector<int> rep_num_auts;
+    mutable std::vector<std::vector<W16>> conductor_classes;
+    mutable size_t class_words;
+    mutable std::vector<W64> class_bits;
+    mutable std::vector<W32> class_ranks;
     Z mass_x24;
     std::unique_ptr<HashMap<W16>> spinor_primes;
-    std::unique_ptr<HashMap<GenusRep<R>>> hash;
+
+    // The genus representatives are stored as a struct of arrays, so that
+    // lookups only touch the reduced forms in the hash table. The remaining
+    // arrays hold, for each representative, the isometries to and from the
+    // mother form, their scalar, and the parent and prime of the neighbor
+    // step which produced it.
+    std::unique_ptr<HashMap<QuadForm<R>>> hash;
+    std::vector<Isometry<R>> rep_isometries;
+    std::vector<Isometry<R>> rep_inverses;
+    std::vector<R> rep_scalars;
+    std::vector<Z64> rep_parents;
+    std::vector<R> rep_primes;
     std::unique_ptr<Spinor<R>> spinor;
     W64 seed_;
 
-    template<typename S, typename T>
-    std::vector<Z32> _eigenvectors(EigenvectorManager<R>& vector_manager, std::shared_ptr<Fp<S,T>> GF, const R& p) const
+    // The number of primes whose neighbors are used to shorten the paths
+    // from the mother form to the genus representatives.
+    static constexpr size_t SHORTEST_PATH_PRIMES = 3;
+
+    size_t conductor_index(const R& conductor) const
+    {
+        size_t num_conductors = this->conductors.size();
+        for (size_t k=0; k<num_conductors; k++)
+        {
+            if (this->conductors[k] == conductor) return k;
+        }
+        throw std::invalid_argument("Invalid conductor.");
+    }
+
+    void ensure_conductors(void) const
+    {
+        size_t num_conductors = this->conductors.size();
+        for (size_t k=0; k<num_conductors; k++)
+        {
+            this->ensure_conductor(k);
+        }
+    }
+
+    // Computes the dimension of the subspace of conductor k and the classes
+    // which contribute to it, unless this has been done before. Every
+    // representative contributes to the trivial conductor, which therefore
+    // does not need the automorphism classes.
+    void ensure_conductor(size_t k) const
+    {
+        static std::mutex mutex;
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (this->conductor_ready[k]) return;
+
+        if (k == 0)
+        {
+            this->dims[k] = this->size();
+            this->conductor_ready[k] = true;
+            return;
+        }
+
+        if (!this->classes_ready) this->build_aut_classes();
+
+        size_t num_classes = this->aut_classes.size();
+        std::vector<W16>& classes = this->conductor_classes[k];
+        for (size_t c=0; c<num_classes; c++)
+        {
+            // A class contributes unless the character of k is nontrivial on
+            // one of the spinor norms of its automorphisms.
+            bool ignore = false;
+            for (Z64 vals : this->aut_classes[c])
+            {
+                if (birch_util::popcnt(vals & k) & 1)
+                {
+                    ignore = true;
+                    break;
+                }
+            }
+
+            if (!ignore)
+            {
+                // The size of the class is its rank past its last word.
+                size_t last = (c+1) * this->class_words - 1;
+                classes.push_back(c);
+                this->dims[k] += this->class_ranks[last] +
+                    __builtin_popcountll(this->class_bits[last]);
+            }
+        }
+
+        this->conductor_ready[k] = true;
+    }
+
+    // Sorts the representatives into classes with equal sets of spinor norms
+    // of their automorphisms, and builds the rank directories of the
+    // classes. The automorphism counts are collected along the way.
+    void build_aut_classes(void) const
+    {
+        size_t genus_size = this->size();
+
+        std::map<std::vector<Z64>,W16> class_map;
+        this->rep_classes.reserve(genus_size);
+        for (size_t n=0; n<genus_size; n++)
+        {
+            const QuadForm<R>& rep = this->hash->get(n);
+
+            const std::vector<Isometry<R>>& auts = QuadForm<R>::proper_automorphisms(rep);
+            std::vector<Z64> norms;
+            for (const Isometry<R>& s : auts)
+            {
+                norms.push_back(this->spinor->norm(rep, s, 1));
+            }
+            std::sort(norms.begin(), norms.end());
+            norms.erase(std::unique(norms.begin(), norms.end()), norms.end());
+
+            auto it = class_map.find(norms);
+            if (it == class_map.end())
+            {
+                W16 c = this->aut_classes.size();
+                it = class_map.insert(std::make_pair(norms, c)).first;
+                this->aut_classes.push_back(norms);
+            }
+            this->rep_classes.push_back(it->second);
+        }
+
+        size_t num_classes = this->aut_classes.size();
+        this->class_words = (genus_size >> 6) + 1;
+        this->class_bits.assign(num_classes * this->class_words, 0);
+        this->class_ranks.assign(num_classes * this->class_words, 0);
+        for (size_t n=0; n<genus_size; n++)
+        {
+            size_t c = this->rep_classes[n];
+            this->class_bits[c * this->class_words + (n >> 6)] |= 1ULL << (n & 63);
+        }
+        for (size_t c=0; c<num_classes; c++)
+        {
+            W32 rank = 0;
+            for (size_t w=0; w<this->class_words; w++)
+            {
+                size_t index = c * this->class_words + w;
+                this->class_ranks[index] = rank;
+                rank += __builtin_popcountll(this->class_bits[index]);
+            }
+        }
+
+        this->classes_ready = true;
+    }
+
+    // Computes the number of automorphisms of each representative, unless
+    // this has been done before.
+    void ensure_automorphism_counts(void) const
+    {
+        static std::mutex mutex;
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!this->rep_num_auts.empty()) return;
+
+        size_t genus_size = this->size();
+        this->rep_num_auts.reserve(genus_size);
+        for (size_t n=0; n<genus_size; n++)
+        {
+            this->rep_num_auts.push_back(QuadForm<R>::num_automorphisms(this->hash->get(n)));
+        }
+    }
+
+    // These assume that the data of conductor k has been computed.
+    bool in_conductor(size_t n, size_t k) const
+    {
+        if (k == 0) return true;
+
+        const std::vector<W16>& classes = this->conductor_classes[k];
+        return std::find(classes.begin(), classes.end(), this->rep_classes[n]) != classes.end();
+    }
+
+    // The position of the n-th representative in the basis of the subspace
+    // of conductor k, or -1 if it does not contribute to it.
+    int conductor_position(size_t n, size_t k) const
+    {
+        if (k == 0) return n;
+        if (!this->in_conductor(n, k)) return -1;
+
+        size_t w = n >> 6;
+        W64 below = (1ULL << (n & 63)) - 1;
+        int pos = 0;
+        for (W16 c : this->conductor_classes[k])
+        {
+            size_t index = c * this->class_words + w;
+            pos += this->class_ranks[index] + __builtin_popcountll(this->class_bits[index] & below);
+        }
+        return pos;
+    }
+
+    // Adds the p-neighbors of the genus representatives found so far to the
+    // hash table, until the mass formula is satisfied. Returns whether the
+    // genus is complete.
+    template<typename F>
+    bool add_neighbors(std::shared_ptr<F> GF, Z& sum_mass_x24)
+    {
+        W16 prime = GF->prime();
+
+        // A temporary placeholder for the genus representatives before they
+        // are fully built.
+        GenusRep<R> foo;
+
+        bool done = (sum_mass_x24 == this->mass_x24);
+        size_t current = 0;
+        while (!done && current < this->hash->size())
+        {
+            // Get the current quadratic form and build the neighbor manager.
+            const QuadForm<R>& mother = this->hash->get(current);
+            this->check_neighbor_precision(mother, prime);
+            NeighborManager<W16,W32,R,F> manager(mother, GF);
+
+            #ifdef DEBUG
+            // Build the affine quadratic form for debugging purposes.
+            QuadFormFp<W16,W32,F> qp = mother.mod(GF);
+            #endif
+
+            for (W16 t=0; !done && t<=prime; t++)
+            {
+                #ifdef DEBUG
+                // Verify that the appropriate vector is isotropic.
+                W16_Vector3 vec = manager.isotropic_vector(t);
+                assert( qp.evaluate(vec) % prime == 0 );
+                #endif
+
+                // Construct the neighbor, the isometry is stored in s.
+                foo.s.set_identity();
+                foo.q = manager.get_neighbor(t, foo.s);
+
+                #ifdef DEBUG
+                // Verify neighbor discriminant matches.
+                assert( foo.q.discriminant() == mother.discriminant() );
+                #endif
+
+                // Reduce the neighbor to its Eisenstein form and add it to
+                // the hash table.
+                foo.q = QuadForm<R>::reduce(foo.q, foo.s);
+
+                bool added = this->hash->add(foo.q);
+                if (added)
+                {
+                    this->rep_isometries.push_back(foo.s);
+                    this->rep_parents.push_back(current);
+                    this->rep_primes.push_back(prime);
+
+                    const QuadForm<R>& temp = this->hash->last();
+                    sum_mass_x24 += 48 / QuadForm<R>::num_automorphisms(temp);
+                    done = (sum_mass_x24 == this->mass_x24);
+                    this->spinor_primes->add(prime);
+                }
+            }
+
+            ++current;
+        }
+
+        return done;
+    }
+
+    // Finds, for each genus representative, a path of smallest scalar from
+    // the mother form in the graph of p-neighbors at several small primes,
+    // with Dijkstra's algorithm, and moves the representative onto it by
+    // updating its parent, prime, and isometry from its parent. Ties are
+    // resolved in favor of the original parent. Returns the representatives
+    // in an order in which parents precede their children.
+    std::vector<size_t> shortest_paths(void)
+    {
+        size_t genus_size = this->size();
+        std::vector<size_t> order;
+        order.reserve(genus_size);
+
+        if (genus_size == 1)
+        {
+            order.push_back(0);
+            return order;
+        }
+
+        std::vector<Isometry<R>> original = this->rep_isometries;
+        std::vector<Z64> original_parents = this->rep_parents;
+        std::vector<R> original_primes = this->rep_primes;
+
+        // Use the primes which were used to build the genus, along with the
+        // smallest good primes.
+        std::vector<W16> primes(this->spinor_primes->keys());
+        Z p = 1;
+        while (primes.size() < SHORTEST_PATH_PRIMES)
+        {
+            mpz_nextprime(p.get_mpz_t(), p.get_mpz_t());
+            W16 prime = mpz_get_ui(p.get_mpz_t());
+            if (this->disc % prime == 0) continue;
+            if (std::find(primes.begin(), primes.end(), prime) == primes.end())
+            {
+                primes.push_back(prime);
+            }
+        }
+
+        std::vector<std::shared_ptr<W16_Fp>> fields;
+        std::shared_ptr<W16_F2> field2;
+        for (W16 prime : primes)
+        {
+            if (prime == 2)
+                field2 = std::make_shared<W16_F2>(prime, this->seed_);
+            else
+                fields.push_back(std::make_shared<W16_Fp>(prime, this->seed_, true));
+        }
+
+        std::vector<R> dist(genus_size);
+        std::vector<bool> reached(genus_size, false);
+        std::vector<bool> settled(genus_size, false);
+
+        typedef std::pair<R,size_t> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        dist[0] = 1;
+        reached[0] = true;
+        queue.push(Entry(dist[0], 0));
+
+        while (!queue.empty())
+        {
+            size_t n = queue.top().second;
+            queue.pop();
+            if (settled[n]) continue;
+            settled[n] = true;
+            order.push_back(n);
+
+            if (field2)
+            {
+                this->relax_neighbors(field2, n, dist, reached, settled, original_parents, original_primes, queue);
+            }
+            for (const std::shared_ptr<W16_Fp>& GF : fields)
+            {
+                this->relax_neighbors(GF, n, dist, reached, settled, original_parents, original_primes, queue);
+            }
+        }
+
+        #ifdef DEBUG
+        assert( order.size() == genus_size );
+        #endif
+
+        // Keep the original isometries of the representatives whose parent did
+        // not change.
+        for (size_t n=1; n<genus_size; n++)
+        {
+            if (this->rep_parents[n] == original_parents[n] && this->rep_primes[n] == original_primes[n])
+            {
+                this->rep_isometries[n] = original[n];
+            }
+        }
+
+        return order;
+    }
+
+    // A genus over a fixed precision type is built without a detour through
+    // arbitrary precision, so we verify in advance that its intermediate
+    // values fit, using the bounds of PrecisionPlanner. This bounds the
+    // p-neighbors of q, their reduction, and the reduction isometries.
+    void check_neighbor_precision(const QuadForm<R>& q, W16 prime) const
+    {
+        if (!std::is_same<R,Z64>::value) return;
+
+        Z D = abs(birch_util::convert_Integer<R,Z>(this->disc));
+        Z B = abs(birch_util::convert_Integer<R,Z>(q.b()));
+        Z F = abs(birch_util::convert_Integer<R,Z>(q.f()));
+        Z C = abs(birch_util::convert_Integer<R,Z>(q.c()));
+        if (B < F) B = F;
+        if (C < B) C = B;
+
+        Z P = prime + 1;
+        Z P2 = P * P;
+        Z bound = C + 2 * B * P2 + B * P2 * P2;
+
+        Z K = 2 * C + 8 * B * P2;
+        if (bound < 4 * K) bound = 4 * K;
+
+        Z X = 16 * prime * prime * K * B * C;
+        mpz_cdiv_q(X.get_mpz_t(), X.get_mpz_t(), D.get_mpz_t());
+        mpz_sqrt(X.get_mpz_t(), X.get_mpz_t());
+        X = 2 * (X + 1);
+        if (bound < X) bound = X;
+
+        Genus<R>::check_precision(bound);
+    }
+
+    // Bounds the composite isometries of a representative, given the
+    // isometry s from its parent and the composite isometries of the parent.
+    static void check_isometry_precision(const Isometry<R>& s, const Isometry<R>& parent,
+                                         const Isometry<R>& parent_inv)
+    {
+        if (!std::is_same<R,Z64>::value) return;
+
+        Z S = Genus<R>::max_entry(s);
+        Z T = Genus<R>::max_entry(parent);
+        Z U = Genus<R>::max_entry(parent_inv);
+        if (T < U) T = U;
+
+        // The adjugate of s, and the products with the parent isometries,
+        // each of which sums three terms.
+        Z bound = 2 * S * S;
+        if (bound < 3 * S * T) bound = 3 * S * T;
+        if (bound < 6 * S * S * T) bound = 6 * S * S * T;
+
+        Genus<R>::check_precision(bound);
+    }
+
+    static Z max_entry(const Isometry<R>& s)
+    {
+        Z x = 0;
+        for (const R *ptr : { &s.a11, &s.a12, &s.a13, &s.a21, &s.a22, &s.a23, &s.a31, &s.a32, &s.a33 })
+        {
+            Z y = abs(birch_util::convert_Integer<R,Z>(*ptr));
+            if (x < y) x = y;
+        }
+        return x;
+    }
+
+    // Leaves one guard bit in addition to the sign bit.
+    static void check_precision(const Z& bound)
+    {
+        if (mpz_sizeinbase(bound.get_mpz_t(), 2) + 2 > 64)
+        {
+            throw std::overflow_error(
+                "An overflow could occur. The genus must be built with "
+                "arbitrary precision.");
+        }
+    }
+
+    template<typename F>
+    void relax_neighbors(std::shared_ptr<F> GF, size_t n, std::vector<R>& dist,
+                         std::vector<bool>& reached, const std::vector<bool>& settled,
+                         const std::vector<Z64>& original_parents,
+                         const std::vector<R>& original_primes,
+                         std::priority_queue<std::pair<R,size_t>,
+                                             std::vector<std::pair<R,size_t>>,
+                                             std::greater<std::pair<R,size_t>>>& queue)
+    {
+        W16 prime = GF->prime();
+        R p = prime;
+
+        if (std::is_same<R,Z64>::value)
+        {
+            Genus<R>::check_precision(birch_util::convert_Integer<R,Z>(dist[n]) * prime);
+        }
+        R cand = dist[n] * p;
+
+        this->check_neighbor_precision(this->hash->get(n), prime);
+        NeighborManager<W16,W32,R,F> manager(this->hash->get(n), GF);
+        GenusRep<R> foo;
+
+        for (W16 t=0; t<=prime; t++)
+        {
+            foo.s.set_identity();
+            foo.q = manager.get_neighbor(t, foo.s);
+            foo.q = QuadForm<R>::reduce(foo.q, foo.s);
+
+            size_t r = this->hash->indexof(foo.q);
+            if (settled[r]) continue;
+
+            bool original = (original_parents[r] == (Z64)n && original_primes[r] == p);
+            if (!reached[r] || cand < dist[r] || (cand == dist[r] && original))
+            {
+                bool improved = !reached[r] || cand < dist[r];
+                dist[r] = cand;
+                reached[r] = true;
+                this->rep_parents[r] = n;
+                this->rep_primes[r] = p;
+                this->rep_isometries[r] = foo.s;
+                if (improved) queue.push(std::make_pair(cand, r));
+            }
+        }
+    }
+
+    template<typename S, typename T, typename F>
+    std::vector<Z32> _eigenvectors(EigenvectorManager<R>& vector_manager, std::shared_ptr<F> GF, const R& p) const
     {
         std::vector<Z32> eigenvalues(vector_manager.size());
 
         S prime = GF->prime();
 
-        const GenusRep<R>& mother = this->hash->get(0);
+        const QuadForm<R>& mother = this->hash->get(0);
 
         const Z32 *stride_ptr = vector_manager.strided_eigenvectors.data();
 
+        // The spinor norms only matter for eigenvectors with nontrivial
+        // conductor, so if there are none the isometries of the neighbors are
+        // not needed.
+        bool track = false;
+        for (W64 cond : vector_manager.conductors)
+        {
+            if (cond != 0) track = true;
+        }
+
+        // Storage for the neighbors, their classes, the partial products of
+        // the composite isometries and their scalars, reused for every
+        // neighbor.
+        std::vector<GenusRep<R>> block(NeighborManager<S,T,R,F>::block_size);
+        std::vector<size_t> block_index(NeighborManager<S,T,R,F>::block_size);
+        Isometry<R> prod;
+        R cur_scalar;
+        R scalar;
+
         size_t num_indices = vector_manager.indices.size();
         for (size_t index=0; index<num_indices; index++)
         {
             size_t npos = static_cast<size_t>(vector_manager.indices[index]);
-            const GenusRep<R>& cur = this->hash->get(npos);
-            NeighborManager<S,T,R> neighbor_manager(cur.q, GF);
-            for (W64 t=0; t<=prime; t++)
-            {
-                GenusRep<R> foo = neighbor_manager.get_reduced_neighbor_rep((S)t);
+            const QuadForm<R>& cur = this->hash->get(npos);
+            const Isometry<R>& cur_s = this->rep_isometries[npos];
+            NeighborManager<S,T,R,F> neighbor_manager(cur, GF);
+            cur_scalar = p;
+            cur_scalar *= this->rep_scalars[npos];
 
-                size_t rpos = this->hash->indexof(foo);
-                size_t offset = vector_manager.stride * rpos;
-                __builtin_prefetch(stride_ptr + offset, 0, 0);
+            for (W64 t0=0; t0<=prime; t0+=block.size())
+            {
+                size_t count = prime + 1 - t0;
+                if (count > block.size()) count = block.size();
+                neighbor_manager.get_reduced_neighbor_reps(t0, count, block.data(), track);
+                this->indexof_many(block.data(), count, block_index.data());
 
-                W64 spin_vals;
-                if (unlikely(rpos == npos))
-                {
-                    spin_vals = this->spinor->norm(foo.q, foo.s, p);
-                }
-                else
+                for (size_t k=0; k<count; k++)
                 {
-                    const GenusRep<R>& rep = this->hash->get(rpos);
-                    foo.s = cur.s * foo.s;
-                    R scalar = p;
+                    GenusRep<R>& foo = block[k];
 
-                    foo.s = foo.s * rep.sinv;
+                    size_t rpos = block_index[k];
+                    size_t offset = vector_manager.stride * rpos;
+                    __builtin_prefetch(stride_ptr + offset, 0, 0);
+
+                    W64 spin_vals;
+                    if (!track)
+                    {
+                        spin_vals = 0;
+                    }
+                    else if (unlikely(rpos == npos))
+                    {
+                        spin_vals = this->spinor->norm(foo.q, foo.s, p);
+                    }
+                    else
+                    {
+                        const Isometry<R>& rep_sinv = this->rep_inverses[rpos];
+                        prod.set_product(cur_s, foo.s);
 
-                    scalar *= birch_util::my_pow(cur.es);
-                    scalar *= birch_util::my_pow(rep.es);
+                        scalar = cur_scalar;
+                        scalar *= this->rep_scalars[rpos];
 
-                    spin_vals = this->spinor->norm(mother.q, foo.s, scalar);
-                }
+                        spin_vals = this->spinor->norm(mother, prod, rep_sinv, scalar);
+                    }
 
-                for (Z64 vpos : vector_manager.position_lut[index])
-                {
-                    W64 cond = vector_manager.conductors[vpos];
-                    Z32 value = birch_util::char_val(spin_vals & cond);
-                    Z32 coord = vector_manager.strided_eigenvectors[offset + vpos];
-                    if (likely(coord))
+                    for (Z64 vpos : vector_manager.position_lut[index])
                     {
-                        eigenvalues[vpos] += (value * coord);
+                        W64 cond = vector_manager.conductors[vpos];
+                        Z32 value = birch_util::char_val(spin_vals & cond);
+                        Z32 coord = vector_manager.strided_eigenvectors[offset + vpos];
+                        if (likely(coord))
+                        {
+                            eigenvalues[vpos] += (value * coord);
+                        }
                     }
                 }
             }
@@ -516,21 +1029,43 @@ private:
     // TODO: Add the actual mass formula here for reference.
     Z get_mass(const QuadForm<R>& q, const std::vector<PrimeSymbol<R>>& symbols)
     {
-        Z mass = 2 * this->disc;
-        Z a = q.h() * q.h() - 4 * q.a() * q.b();
-        Z b = -q.a() * this->disc;
+        Z disc = birch_util::convert_Integer<R,Z>(this->disc);
+        Z qa = birch_util::convert_Integer<R,Z>(q.a());
+        Z qb = birch_util::convert_Integer<R,Z>(q.b());
+        Z qh = birch_util::convert_Integer<R,Z>(q.h());
+
+        Z mass = 2 * disc;
+        Z a = qh * qh - 4 * qa * qb;
+        Z b = -qa * disc;
 
         for (const PrimeSymbol<R>& symb : symbols)
         {
-            mass *= (symb.p + Math<Z>::hilbert_symbol(a, b, symb.p));
+            Z p = birch_util::convert_Integer<R,Z>(symb.p);
+            mass *= (p + Math<Z>::hilbert_symbol(a, b, p));
             mass /= 2;
-            mass /= symb.p;
+            mass /= p;
         }
 
         return mass;
     }
 
     std::map<R,std::vector<std::vector<int>>> hecke_matrix_sparse_internal(const R& p) const
+    {
+        W16 prime = birch_util::convert_Integer<R,W16>(p);
+        if (prime == 2)
+        {
+            std::shared_ptr<W16_F2> GF = std::make_shared<W16_F2>(2, this->seed());
+            return this->hecke_matrix_sparse_internal(p, GF);
+        }
+        else
+        {
+            std::shared_ptr<W16_Fp> GF = std::make_shared<W16_Fp>(prime, this->seed(), true);
+            return this->hecke_matrix_sparse_internal(p, GF);
+        }
+    }
+
+    template<typename F>
+    std::map<R,std::vector<std::vector<int>>> hecke_matrix_sparse_internal(const R& p, std::shared_ptr<F> GF) const
     {
         size_t num_conductors = this->conductors.size();
         size_t num_primes = this->prime_divisors.size();
@@ -541,15 +1076,11 @@ private:
 
         W16 prime = birch_util::convert_Integer<R,W16>(p);
 
-        std::shared_ptr<W16_Fp> GF;
-        if (prime == 2)
-            GF = std::make_shared<W16_F2>(2, this->seed());
-        else
-            GF = std::make_shared<W16_Fp>((W16)prime, this->seed(), true);
-
         std::vector<W64> all_spin_vals;
         all_spin_vals.reserve(prime+1);
 
+        this->ensure_conductors();
+
         std::vector<std::vector<int>> rowdata;
         for (int dim : this->dims)
         {
@@ -557,70 +1088,100 @@ private:
             indptr.push_back(std::vector<int>(dim+1, 0));
         }
 
-        const GenusRep<R>& mother = this->hash->keys()[0];
+        // The spinor norms only matter for the nontrivial conductors, so if
+        // their subspaces are all zero the isometries of the neighbors are
+        // not needed.
+        bool track = false;
+        for (size_t k=1; k<num_conductors; k++)
+        {
+            if (this->dims[k] > 0) track = true;
+        }
+
+        // Storage for the neighbors, their classes, the partial products of
+        // the composite isometries and their scalars, reused for every
+        // neighbor.
+        std::vector<GenusRep<R>> block(NeighborManager<W16,W32,R,F>::block_size);
+        std::vector<size_t> block_index(NeighborManager<W16,W32,R,F>::block_size);
+        Isometry<R> prod;
+        R cur_scalar;
+        R scalar;
+
+        const QuadForm<R>& mother = this->hash->get(0);
         size_t num_reps = this->size();
         for (size_t n=0; n<num_reps; n++)
         {
-            const GenusRep<R>& cur = this->hash->get(n);
-            NeighborManager<W16,W32,R> manager(cur.q, GF);
+            const QuadForm<R>& cur = this->hash->get(n);
+            const Isometry<R>& cur_s = this->rep_isometries[n];
+            NeighborManager<W16,W32,R,F> manager(cur, GF);
+            cur_scalar = p;
+            cur_scalar *= this->rep_scalars[n];
 
-            for (W16 t=0; t<=prime; t++)
+            for (W64 t0=0; t0<=prime; t0+=block.size())
             {
-                GenusRep<R> foo = manager.get_reduced_neighbor_rep(t);
-
-                #ifdef DEBUG
-                assert( foo.s.is_isometry(cur.q, foo.q, p*p) );
-                #endif
-
-                size_t r = this->hash->indexof(foo);
-
-                #ifdef DEBUG
-                assert( r < this->size() );
-                #endif
+                size_t count = prime + 1 - t0;
+                if (count > block.size()) count = block.size();
+                manager.get_reduced_neighbor_reps(t0, count, block.data(), track);
+                this->indexof_many(block.data(), count, block_index.data());
 
-                W64 spin_vals;
-                if (r == n)
+                for (size_t k=0; k<count; k++)
                 {
-                    spin_vals = this->spinor->norm(foo.q, foo.s, p);
-                }
-                else
-                {
-                    const GenusRep<R>& rep = this->hash->get(r);
-                    foo.s = cur.s * foo.s;
-                    R scalar = p;
+                    GenusRep<R>& foo = block[k];
 
                     #ifdef DEBUG
-                    R temp_scalar = p*p;
-                    R temp = birch_util::my_pow(cur.es);
-                    temp_scalar *= temp * temp;
-                    assert( foo.s.is_isometry(mother.q, foo.q, temp_scalar) );
+                    if (track) assert( foo.s.is_isometry(cur, foo.q, p*p) );
                     #endif
 
-                    foo.s = foo.s * rep.sinv;
+                    size_t r = block_index[k];
 
                     #ifdef DEBUG
-                    temp = birch_util::my_pow(rep.es);
-                    temp_scalar *= temp * temp;
-                    assert( foo.s.is_isometry(mother.q, mother.q, temp_scalar) );
+                    assert( r < this->size() );
                     #endif
 
-                    scalar *= birch_util::my_pow(cur.es);
-                    scalar *= birch_util::my_pow(rep.es);
-
-                    #ifdef DEBUG
-                    assert( scalar*scalar == temp_scalar );
-                    #endif
+                    W64 spin_vals;
+                    if (!track)
+                    {
+                        spin_vals = 0;
+                    }
+                    else if (r == n)
+                    {
+                        spin_vals = this->spinor->norm(foo.q, foo.s, p);
+                    }
+                    else
+                    {
+                        const Isometry<R>& rep_sinv = this->rep_inverses[r];
+                        prod.set_product(cur_s, foo.s);
+
+                        #ifdef DEBUG
+                        R temp_scalar = p*p;
+                        R temp = this->rep_scalars[n];
+                        temp_scalar *= temp * temp;
+                        assert( prod.is_isometry(mother, foo.q, temp_scalar) );
+                        #endif
+
+                        #ifdef DEBUG
+                        foo.s.set_product(prod, rep_sinv);
+                        temp = this->rep_scalars[r];
+                        temp_scalar *= temp * temp;
+                        assert( foo.s.is_isometry(mother, mother, temp_scalar) );
+                        #endif
+
+                        scalar = cur_scalar;
+                        scalar *= this->rep_scalars[r];
+
+                        #ifdef DEBUG
+                        assert( scalar*scalar == temp_scalar );
+                        #endif
+
+                        spin_vals = this->spinor->norm(mother, prod, rep_sinv, scalar);
+                    }
 
-                    spin_vals = this->spinor->norm(mother.q, foo.s, scalar);
+                    all_spin_vals.push_back((r << num_primes) | spin_vals);
                 }
-
-                all_spin_vals.push_back((r << num_primes) | spin_vals);
             }
 
             for (size_t k=0; k<num_conductors; k++)
             {
-                const std::vector<int>& lut = this->lut_positions[k];
-                int npos = lut[n];
+                int npos = this->conductor_position(n, k);
                 if (npos == -1) continue;
 
                 // Populate the row data.
@@ -628,7 +1189,7 @@ private:
                 for (W64 x : all_spin_vals)
                 {
                     int r = x >> num_primes;
-                    int rpos = lut[r];
+                    int rpos = this->conductor_position(r, k);
                     if (rpos == -1) continue;
 
                     int value = birch_util::char_val(x & k);
@@ -672,10 +1233,29 @@ private:
     }
 
     std::map<R,std::vector<int>> hecke_matrix_dense_internal(const R& p) const
+    {
+        W16 prime = birch_util::convert_Integer<R,W16>(p);
+        if (prime == 2)
+        {
+            std::shared_ptr<W16_F2> GF = std::make_shared<W16_F2>(2, this->seed());
+            return this->hecke_matrix_dense_internal(p, GF);
+        }
+        else
+        {
+            std::shared_ptr<W16_Fp> GF = std::make_shared<W16_Fp>(prime, this->seed(), true);
+            return this->hecke_matrix_dense_internal(p, GF);
+        }
+    }
+
+    template<typename F>
+    std::map<R,std::vector<int>> hecke_matrix_dense_internal(const R& p, std::shared_ptr<F> GF) const
     {
         size_t num_conductors = this->conductors.size();
         size_t num_primes = this->prime_divisors.size();
 
+        this->ensure_conductors();
+        this->ensure_automorphism_counts();
+
         // Allocate memory for the Hecke matrices and create a vector to store
         // pointers to the raw matrix data.
         std::vector<int*> hecke_ptr;
@@ -692,27 +1272,30 @@ private:
         std::vector<W64> all_spin_vals;
         all_spin_vals.reserve(prime+1);
 
-        std::shared_ptr<W16_Fp> GF;
-        if (prime == 2)
-            GF = std::make_shared<W16_F2>(2, this->seed());
-        else
-            GF = std::make_shared<W16_Fp>((W16)prime, this->seed(), true);
-
-        const GenusRep<R>& mother = this->hash->keys()[0];
+        const QuadForm<R>& mother = this->hash->get(0);
         size_t num_reps = this->size();
 
         // Create hash tables for storing isotropic vectors to be skipped
         // at later iterations.
         std::vector<HashMap<W16_Vector3>> vector_hash(num_reps);
 
+        // Storage for the neighbors, the partial products of the composite
+        // isometries and their scalars, reused for every neighbor.
+        GenusRep<R> foo;
+        Isometry<R> prod;
+        R cur_scalar;
+        R scalar;
+
         for (size_t n=0; n<num_reps; n++)
         {
-            const GenusRep<R>& cur = this->hash->get(n);
-            NeighborManager<W16,W32,R> manager(cur.q, GF);
+            const QuadForm<R>& cur = this->hash->get(n);
+            const Isometry<R>& cur_s = this->rep_isometries[n];
+            NeighborManager<W16,W32,R,F> manager(cur, GF);
+            cur_scalar = p;
+            cur_scalar *= this->rep_scalars[n];
 
             for (W16 t=0; t<=prime; t++)
             {
-                GenusRep<R> foo;
                 W16_Vector3 vec = manager.isotropic_vector(t);
                 vec.x = GF->mod(vec.x);
                 vec.y = GF->mod(vec.y);
@@ -730,10 +1313,10 @@ private:
                 foo.q = QuadForm<R>::reduce(foo.q, foo.s);
 
                 #ifdef DEBUG
-                assert( foo.s.is_isometry(cur.q, foo.q, p*p) );
+                assert( foo.s.is_isometry(cur, foo.q, p*p) );
                 #endif
 
-                size_t r = this->hash->indexof(foo);
+                size_t r = this->hash->indexof(foo.q);
 
                 #ifdef DEBUG
                 assert( r < this->size() );
@@ -745,33 +1328,31 @@ private:
                     W16_Vector3 result = manager.transform_vector(foo, vec);
                     vector_hash[r].add(result);
 
-                    const GenusRep<R>& rep = this->hash->get(r);
-                    foo.s = cur.s * foo.s;
-                    R scalar = p;
+                    const Isometry<R>& rep_sinv = this->rep_inverses[r];
+                    prod.set_product(cur_s, foo.s);
 
                     #ifdef DEBUG
                     R temp_scalar = p*p;
-                    R temp = birch_util::my_pow(cur.es);
+                    R temp = this->rep_scalars[n];
                     temp_scalar *= temp * temp;
-                    assert( foo.s.is_isometry(mother.q, foo.q, temp_scalar) );
+                    assert( prod.is_isometry(mother, foo.q, temp_scalar) );
                     #endif
 
-                    foo.s = foo.s * rep.sinv;
-
                     #ifdef DEBUG
-                    temp = birch_util::my_pow(rep.es);
+                    foo.s.set_product(prod, rep_sinv);
+                    temp = this->rep_scalars[r];
                     temp_scalar *= temp * temp;
-                    assert( foo.s.is_isometry(mother.q, mother.q, temp_scalar) );
+                    assert( foo.s.is_isometry(mother, mother, temp_scalar) );
                     #endif
 
-                    scalar *= birch_util::my_pow(cur.es);
-                    scalar *= birch_util::my_pow(rep.es);
+                    scalar = cur_scalar;
+                    scalar *= this->rep_scalars[r];
 
                     #ifdef DEBUG
                     assert( scalar*scalar == temp_scalar );
                     #endif
 
-                    spin_vals = this->spinor->norm(mother.q, foo.s, scalar);
+                    spin_vals = this->spinor->norm(mother, prod, rep_sinv, scalar);
                 }
                 else if (r == n)
                 {
@@ -784,8 +1365,7 @@ private:
 
             for (size_t k=0; k<num_conductors; k++)
             {
-                const std::vector<int>& lut = this->lut_positions[k];
-                int npos = lut[n];
+                int npos = this->conductor_position(n, k);
                 if (unlikely(npos == -1)) continue;
 
                 int *row = hecke_ptr[k];
@@ -793,7 +1373,7 @@ private:
                 for (W64 x : all_spin_vals)
                 {
                     int r = x >> num_primes;
-                    int rpos = lut[r];
+                    int rpos = this->conductor_position(r, k);
                     if (unlikely(rpos == -1)) continue;
 
                     row[rpos] += birch_util::char_val(x & k);
@@ -814,7 +1394,14 @@ private:
             std::vector<int>& matrix = hecke_matrices[k];
             size_t dim = this->dims[k];
             size_t dim2 = dim * dim;
-            const std::vector<size_t>& auts = this->num_auts[k];
+
+            // The automorphism counts of the representatives in this subspace.
+            std::vector<int> auts;
+            auts.reserve(dim);
+            for (size_t n=0; n<num_reps; n++)
+            {
+                if (this->in_conductor(n, k)) auts.push_back(this->rep_num_auts[n]);
+            }
 
             // Copy upper diagonal matrix to the lower diagonal.
             for (size_t start=0, row=0; start<dim2; start+=dim+1, row++)
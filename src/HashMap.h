@@ -1,6 +1,7 @@
 #ifndef __HASHMAP_H_
 #define __HASHMAP_H_
 
+#include <algorithm>
 #include "birch.h"
 
 template<typename Key>
@@ -29,14 +30,108 @@ public:
     bool add(const Key& key)
     {
         W64 value = std::hash<Key>{}(key);
+        if (this->frozen()) this->thaw();
         return this->add(key, value, true);
     }
 
     bool add(const Key& key, W64 value)
     {
+        if (this->frozen()) this->thaw();
         return this->add(key, value, true);
     }
 
+    // Replaces the open addressing index by a minimal perfect hash of the
+    // stored keys, built with hash and displace: the keys are split into
+    // small buckets, and each bucket, from the largest down, is given the
+    // first pilot value that sends all of its keys to free slots. A lookup
+    // then reads one pilot and one slot and compares a single key. Adding a
+    // key to a frozen table restores the open addressing index. If two keys
+    // share their full hash value, the table is left as it is.
+    void freeze(void)
+    {
+        size_t n = this->keys_.size();
+        if (this->frozen() || n == 0) return;
+
+        size_t num_buckets = n / FROZEN_BUCKET_SIZE + 1;
+
+        // Sort the keys by bucket, with a counting sort.
+        std::vector<W32> start(num_buckets + 1, 0);
+        for (size_t k=0; k<n; k++)
+        {
+            ++start[bucket_of(this->vals[k], num_buckets) + 1];
+        }
+        for (size_t b=0; b<num_buckets; b++)
+        {
+            start[b+1] += start[b];
+        }
+
+        std::vector<W32> order(n);
+        std::vector<W32> fill(start.begin(), start.end()-1);
+        for (size_t k=0; k<n; k++)
+        {
+            order[fill[bucket_of(this->vals[k], num_buckets)]++] = k;
+        }
+
+        // Place the largest buckets first, while most slots are free.
+        std::vector<W32> buckets(num_buckets);
+        for (size_t b=0; b<num_buckets; b++) buckets[b] = b;
+        std::stable_sort(buckets.begin(), buckets.end(), [&start](W32 x, W32 y) {
+            return start[x+1] - start[x] > start[y+1] - start[y];
+        });
+
+        std::vector<W32> pilots(num_buckets, 0);
+        std::vector<W32> slots(n, (W32)FROZEN_EMPTY);
+        std::vector<W64> positions;
+
+        for (W32 b : buckets)
+        {
+            W32 first = start[b];
+            W32 last = start[b+1];
+            if (first == last) break;
+
+            for (W32 i=first; i<last; i++)
+            {
+                for (W32 j=first; j<i; j++)
+                {
+                    if (this->vals[order[i]] == this->vals[order[j]]) return;
+                }
+            }
+
+            W32 pilot = 0;
+            while (1)
+            {
+                positions.clear();
+                W32 i = first;
+                for (; i<last; i++)
+                {
+                    W64 pos = position_of(this->vals[order[i]], pilot, n);
+                    if (slots[pos] != FROZEN_EMPTY) break;
+                    if (std::find(positions.begin(), positions.end(), pos) != positions.end()) break;
+                    positions.push_back(pos);
+                }
+                if (i == last) break;
+
+                if (++pilot == FROZEN_EMPTY) return;
+            }
+
+            for (W32 i=first; i<last; i++)
+            {
+                slots[positions[i-first]] = order[i];
+            }
+            pilots[b] = pilot;
+        }
+
+        this->pilots = std::move(pilots);
+        this->slots = std::move(slots);
+        this->keyptr.clear();
+        this->keyptr.shrink_to_fit();
+    }
+
+    bool frozen(void) const
+    {
+        return !this->slots.empty();
+    }
+
     const Key& get(size_t index) const
     {
         return this->keys_[index];
@@ -45,16 +140,22 @@ public:
     bool exists(const Key& key) const
     {
         W64 value = std::hash<Key>{}(key);
+        if (this->frozen())
+        {
+            W32 offset = this->frozen_offset(value);
+            return key == this->keys_[offset];
+        }
+
         size_t index = value & this->mask;
         while (1)
         {
-            Z64 offset = this->keyptr[index];
-            if (offset == -1)
+            Z64 slot = this->keyptr[index];
+            if (slot == -1)
             {
                 return false;
             }
 
-            if (key == this->keys_[offset])
+            if (same_tag(slot, value) && key == this->keys_[offset_of(slot)])
             {
                 return true;
             }
@@ -68,24 +169,74 @@ public:
     size_t indexof(const Key& key) const
     {
         W64 value = std::hash<Key>{}(key);
-        size_t index = value & this->mask;
-        while (1)
+        return this->indexof(key, value);
+    }
+
+    // Finds the indices of n keys at once. The keys are handled in groups:
+    // the hash values of a whole group are computed and the memory each
+    // lookup reads is prefetched for all keys of the group before it is
+    // read for any of them, so that the cache misses overlap.
+    void indexof_many(const Key *keys, size_t n, size_t *indices) const
+    {
+        this->indexof_many(keys, n, indices, [](const Key& key) -> const Key& { return key; });
+    }
+
+    // As above, for items from which key_of extracts the keys.
+    template<typename T, typename KeyOf>
+    void indexof_many(const T *items, size_t n, size_t *indices, KeyOf key_of) const
+    {
+        W64 values[INDEXOF_GROUP_SIZE];
+        W64 positions[INDEXOF_GROUP_SIZE];
+
+        for (size_t k0=0; k0<n; k0+=INDEXOF_GROUP_SIZE)
         {
-            Z64 offset = this->keyptr[index];
-            if (offset == -1)
+            size_t count = n - k0;
+            if (count > INDEXOF_GROUP_SIZE) count = INDEXOF_GROUP_SIZE;
+            const T *group = items + k0;
+            size_t *out = indices + k0;
+
+            for (size_t k=0; k<count; k++)
             {
-                throw std::invalid_argument("Key not found.");
+                values[k] = std::hash<Key>{}(key_of(group[k]));
             }
 
-            if (key == this->keys_[offset])
+            if (!this->frozen())
             {
-                return offset;
+                for (size_t k=0; k<count; k++)
+                {
+                    __builtin_prefetch(&this->keyptr[values[k] & this->mask], 0, 0);
+                }
+                for (size_t k=0; k<count; k++)
+                {
+                    out[k] = this->indexof(key_of(group[k]), values[k]);
+                }
+                continue;
             }
 
-            index = (index + 1) & this->mask;
+            size_t num_buckets = this->pilots.size();
+            for (size_t k=0; k<count; k++)
+            {
+                __builtin_prefetch(&this->pilots[bucket_of(values[k], num_buckets)], 0, 0);
+            }
+            for (size_t k=0; k<count; k++)
+            {
+                W32 pilot = this->pilots[bucket_of(values[k], num_buckets)];
+                positions[k] = position_of(values[k], pilot, this->slots.size());
+                __builtin_prefetch(&this->slots[positions[k]], 0, 0);
+            }
+            for (size_t k=0; k<count; k++)
+            {
+                out[k] = this->slots[positions[k]];
+                __builtin_prefetch(&this->keys_[out[k]], 0, 0);
+            }
+            for (size_t k=0; k<count; k++)
+            {
+                if (!(key_of(group[k]) == this->keys_[out[k]]))
+                {
+                    throw std::invalid_argument("Key not found.");
+                }
+            }
         }
-
-        return -1;
     }
 
     Key& at(size_t index)
@@ -103,19 +254,148 @@ public:
         return this->keys_;
     }
 
+    // The fraction of occupied slots.
+    double load_factor(void) const
+    {
+        if (this->frozen()) return 1.0;
+        return (double)this->num_stored / this->keyptr.size();
+    }
+
+    // The average and maximum number of slots probed to find a stored key.
+    double mean_probe_length(void) const
+    {
+        if (this->num_stored == 0) return 0.0;
+        if (this->frozen()) return 1.0;
+
+        size_t total = 0;
+        for (size_t index=0; index<this->keyptr.size(); index++)
+        {
+            total += this->probe_length(index);
+        }
+        return (double)total / this->num_stored;
+    }
+
+    size_t max_probe_length(void) const
+    {
+        if (this->frozen()) return 1;
+
+        size_t longest = 0;
+        for (size_t index=0; index<this->keyptr.size(); index++)
+        {
+            longest = std::max(longest, this->probe_length(index));
+        }
+        return longest;
+    }
+
 private:
+    // Each slot of keyptr stores the offset of its key in the low 32 bits and
+    // the high 32 bits of the key's hash in the high bits, or -1 if it is
+    // empty. Comparing the hashes first avoids comparing the full keys on
+    // almost every collision.
+    static Z64 make_slot(Z64 offset, W64 value)
+    {
+        return (Z64)((value & 0xffffffff00000000ULL) | (W64)offset);
+    }
+
+    static Z64 offset_of(Z64 slot)
+    {
+        return slot & 0xffffffff;
+    }
+
+    static bool same_tag(Z64 slot, W64 value)
+    {
+        return (((W64)slot ^ value) >> 32) == 0;
+    }
+
+    size_t indexof(const Key& key, W64 value) const
+    {
+        if (this->frozen())
+        {
+            W32 offset = this->frozen_offset(value);
+            if (key == this->keys_[offset])
+            {
+                return offset;
+            }
+            throw std::invalid_argument("Key not found.");
+        }
+
+        size_t index = value & this->mask;
+        while (1)
+        {
+            Z64 slot = this->keyptr[index];
+            if (slot == -1)
+            {
+                throw std::invalid_argument("Key not found.");
+            }
+
+            if (same_tag(slot, value) && key == this->keys_[offset_of(slot)])
+            {
+                return offset_of(slot);
+            }
+
+            index = (index + 1) & this->mask;
+        }
+
+        return -1;
+    }
+
+    static W64 bucket_of(W64 value, size_t num_buckets)
+    {
+        return (W64)(((W128)value * num_buckets) >> 64);
+    }
+
+    static W64 position_of(W64 value, W32 pilot, size_t num_slots)
+    {
+        W64 x = value ^ (pilot * 0x9e3779b97f4a7c15ULL);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return (W64)(((W128)x * num_slots) >> 64);
+    }
+
+    W32 frozen_offset(W64 value) const
+    {
+        W32 pilot = this->pilots[bucket_of(value, this->pilots.size())];
+        return this->slots[position_of(value, pilot, this->slots.size())];
+    }
+
+    // Restores the open addressing index of a frozen table.
+    void thaw(void)
+    {
+        this->pilots.clear();
+        this->slots.clear();
+        this->keyptr.resize(this->capacity_ << 1, -1);
+
+        Z64 stored = this->num_stored;
+        this->num_stored = 0;
+
+        for (Z64 n=0; n<stored; n++)
+        {
+            this->add(this->keys_[n], this->vals[n], false);
+        }
+    }
+
+    size_t probe_length(size_t index) const
+    {
+        Z64 slot = this->keyptr[index];
+        if (slot == -1) return 0;
+
+        W64 home = this->vals[offset_of(slot)] & this->mask;
+        return ((index - home) & this->mask) + 1;
+    }
+
     bool add(const Key& key, W64 value, bool do_push_back)
     {
         Z64 index = value & this->mask;
         while (1)
         {
-            Z64 offset = this->keyptr[index];
-            if (offset == -1)
+            Z64 slot = this->keyptr[index];
+            if (slot == -1)
             {
                 return this->insert(key, value, index, do_push_back);
             }
 
-            if (key == this->keys_[offset])
+            if (same_tag(slot, value) && key == this->keys_[offset_of(slot)])
             {
                 return false;
             }
@@ -136,12 +416,16 @@ private:
         Z64 offset = this->num_stored;
         ++this->num_stored;
 
+        #ifdef DEBUG
+        assert( offset < 0xffffffff );
+        #endif
+
         if (do_push_back)
         {
             this->keys_.emplace_back(key);
             this->vals.emplace_back(value);
         }
-        this->keyptr[index] = offset;
+        this->keyptr[index] = make_slot(offset, value);
 
         return true;
     }
@@ -171,8 +455,13 @@ private:
     std::vector<Key> keys_;
     std::vector<W64> vals;
     std::vector<Z64> keyptr;
+    std::vector<W32> pilots;
+    std::vector<W32> slots;
 
     static constexpr int DEFAULT_LG2_CAPACITY = 4;
+    static constexpr size_t FROZEN_BUCKET_SIZE = 4;
+    static constexpr W32 FROZEN_EMPTY = 0xffffffff;
+    static constexpr size_t INDEXOF_GROUP_SIZE = 16;
 };
 
 #endif // __HASHMAP_H_
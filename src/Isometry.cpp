@@ -17,85 +17,77 @@ void Z_Isometry::set_identity(void)
 }
 
 template<>
-Z_Isometry Z_Isometry::inverse(const Z& p) const
+void Z_Isometry::set_inverse(const Z_Isometry& s, const Z& p)
 {
-    Z_Isometry temp;
-
-    mpz_mul(temp.a11.get_mpz_t(), a22.get_mpz_t(), a33.get_mpz_t());
-    mpz_mul(temp.a12.get_mpz_t(), a13.get_mpz_t(), a32.get_mpz_t());
-    mpz_mul(temp.a13.get_mpz_t(), a12.get_mpz_t(), a23.get_mpz_t());
-    mpz_mul(temp.a21.get_mpz_t(), a23.get_mpz_t(), a31.get_mpz_t());
-    mpz_mul(temp.a22.get_mpz_t(), a11.get_mpz_t(), a33.get_mpz_t());
-    mpz_mul(temp.a23.get_mpz_t(), a13.get_mpz_t(), a21.get_mpz_t());
-    mpz_mul(temp.a31.get_mpz_t(), a21.get_mpz_t(), a32.get_mpz_t());
-    mpz_mul(temp.a32.get_mpz_t(), a12.get_mpz_t(), a31.get_mpz_t());
-    mpz_mul(temp.a33.get_mpz_t(), a11.get_mpz_t(), a22.get_mpz_t());
-
-    mpz_submul(temp.a11.get_mpz_t(), a23.get_mpz_t(), a32.get_mpz_t());
-    mpz_submul(temp.a12.get_mpz_t(), a12.get_mpz_t(), a33.get_mpz_t());
-    mpz_submul(temp.a13.get_mpz_t(), a13.get_mpz_t(), a22.get_mpz_t());
-    mpz_submul(temp.a21.get_mpz_t(), a21.get_mpz_t(), a33.get_mpz_t());
-    mpz_submul(temp.a22.get_mpz_t(), a13.get_mpz_t(), a31.get_mpz_t());
-    mpz_submul(temp.a23.get_mpz_t(), a11.get_mpz_t(), a23.get_mpz_t());
-    mpz_submul(temp.a31.get_mpz_t(), a22.get_mpz_t(), a31.get_mpz_t());
-    mpz_submul(temp.a32.get_mpz_t(), a11.get_mpz_t(), a32.get_mpz_t());
-    mpz_submul(temp.a33.get_mpz_t(), a12.get_mpz_t(), a21.get_mpz_t());
-
-    mpz_divexact(temp.a11.get_mpz_t(), temp.a11.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a12.get_mpz_t(), temp.a12.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a13.get_mpz_t(), temp.a13.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a21.get_mpz_t(), temp.a21.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a22.get_mpz_t(), temp.a22.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a23.get_mpz_t(), temp.a23.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a31.get_mpz_t(), temp.a31.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a32.get_mpz_t(), temp.a32.get_mpz_t(), p.get_mpz_t());
-    mpz_divexact(temp.a33.get_mpz_t(), temp.a33.get_mpz_t(), p.get_mpz_t());
-
-    return temp;
+    mpz_mul(this->a11.get_mpz_t(), s.a22.get_mpz_t(), s.a33.get_mpz_t());
+    mpz_mul(this->a12.get_mpz_t(), s.a13.get_mpz_t(), s.a32.get_mpz_t());
+    mpz_mul(this->a13.get_mpz_t(), s.a12.get_mpz_t(), s.a23.get_mpz_t());
+    mpz_mul(this->a21.get_mpz_t(), s.a23.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_mul(this->a22.get_mpz_t(), s.a11.get_mpz_t(), s.a33.get_mpz_t());
+    mpz_mul(this->a23.get_mpz_t(), s.a13.get_mpz_t(), s.a21.get_mpz_t());
+    mpz_mul(this->a31.get_mpz_t(), s.a21.get_mpz_t(), s.a32.get_mpz_t());
+    mpz_mul(this->a32.get_mpz_t(), s.a12.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_mul(this->a33.get_mpz_t(), s.a11.get_mpz_t(), s.a22.get_mpz_t());
+
+    mpz_submul(this->a11.get_mpz_t(), s.a23.get_mpz_t(), s.a32.get_mpz_t());
+    mpz_submul(this->a12.get_mpz_t(), s.a12.get_mpz_t(), s.a33.get_mpz_t());
+    mpz_submul(this->a13.get_mpz_t(), s.a13.get_mpz_t(), s.a22.get_mpz_t());
+    mpz_submul(this->a21.get_mpz_t(), s.a21.get_mpz_t(), s.a33.get_mpz_t());
+    mpz_submul(this->a22.get_mpz_t(), s.a13.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_submul(this->a23.get_mpz_t(), s.a11.get_mpz_t(), s.a23.get_mpz_t());
+    mpz_submul(this->a31.get_mpz_t(), s.a22.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_submul(this->a32.get_mpz_t(), s.a11.get_mpz_t(), s.a32.get_mpz_t());
+    mpz_submul(this->a33.get_mpz_t(), s.a12.get_mpz_t(), s.a21.get_mpz_t());
+
+    mpz_divexact(this->a11.get_mpz_t(), this->a11.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a12.get_mpz_t(), this->a12.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a13.get_mpz_t(), this->a13.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a21.get_mpz_t(), this->a21.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a22.get_mpz_t(), this->a22.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a23.get_mpz_t(), this->a23.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a31.get_mpz_t(), this->a31.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a32.get_mpz_t(), this->a32.get_mpz_t(), p.get_mpz_t());
+    mpz_divexact(this->a33.get_mpz_t(), this->a33.get_mpz_t(), p.get_mpz_t());
 }
 
 template<>
-Z_Isometry Z_Isometry::operator*(const Z_Isometry& s) const
+void Z_Isometry::set_product(const Z_Isometry& s1, const Z_Isometry& s2)
 {
-    Z_Isometry temp;
+    mpz_mul(this->a11.get_mpz_t(), s1.a11.get_mpz_t(), s2.a11.get_mpz_t());
+    mpz_addmul(this->a11.get_mpz_t(), s1.a12.get_mpz_t(), s2.a21.get_mpz_t());
+    mpz_addmul(this->a11.get_mpz_t(), s1.a13.get_mpz_t(), s2.a31.get_mpz_t());
 
-    mpz_mul(temp.a11.get_mpz_t(), a11.get_mpz_t(), s.a11.get_mpz_t());
-    mpz_addmul(temp.a11.get_mpz_t(), a12.get_mpz_t(), s.a21.get_mpz_t());
-    mpz_addmul(temp.a11.get_mpz_t(), a13.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_mul(this->a12.get_mpz_t(), s1.a11.get_mpz_t(), s2.a12.get_mpz_t());
+    mpz_addmul(this->a12.get_mpz_t(), s1.a12.get_mpz_t(), s2.a22.get_mpz_t());
+    mpz_addmul(this->a12.get_mpz_t(), s1.a13.get_mpz_t(), s2.a32.get_mpz_t());
 
-    mpz_mul(temp.a12.get_mpz_t(), a11.get_mpz_t(), s.a12.get_mpz_t());
-    mpz_addmul(temp.a12.get_mpz_t(), a12.get_mpz_t(), s.a22.get_mpz_t());
-    mpz_addmul(temp.a12.get_mpz_t(), a13.get_mpz_t(), s.a32.get_mpz_t());
+    mpz_mul(this->a13.get_mpz_t(), s1.a11.get_mpz_t(), s2.a13.get_mpz_t());
+    mpz_addmul(this->a13.get_mpz_t(), s1.a12.get_mpz_t(), s2.a23.get_mpz_t());
+    mpz_addmul(this->a13.get_mpz_t(), s1.a13.get_mpz_t(), s2.a33.get_mpz_t());
 
-    mpz_mul(temp.a13.get_mpz_t(), a11.get_mpz_t(), s.a13.get_mpz_t());
-    mpz_addmul(temp.a13.get_mpz_t(), a12.get_mpz_t(), s.a23.get_mpz_t());
-    mpz_addmul(temp.a13.get_mpz_t(), a13.get_mpz_t(), s.a33.get_mpz_t());
+    mpz_mul(this->a21.get_mpz_t(), s1.a21.get_mpz_t(), s2.a11.get_mpz_t());
+    mpz_addmul(this->a21.get_mpz_t(), s1.a22.get_mpz_t(), s2.a21.get_mpz_t());
+    mpz_addmul(this->a21.get_mpz_t(), s1.a23.get_mpz_t(), s2.a31.get_mpz_t());
 
-    mpz_mul(temp.a21.get_mpz_t(), a21.get_mpz_t(), s.a11.get_mpz_t());
-    mpz_addmul(temp.a21.get_mpz_t(), a22.get_mpz_t(), s.a21.get_mpz_t());
-    mpz_addmul(temp.a21.get_mpz_t(), a23.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_mul(this->a22.get_mpz_t(), s1.a21.get_mpz_t(), s2.a12.get_mpz_t());
+    mpz_addmul(this->a22.get_mpz_t(), s1.a22.get_mpz_t(), s2.a22.get_mpz_t());
+    mpz_addmul(this->a22.get_mpz_t(), s1.a23.get_mpz_t(), s2.a32.get_mpz_t());
 
-    mpz_mul(temp.a22.get_mpz_t(), a21.get_mpz_t(), s.a12.get_mpz_t());
-    mpz_addmul(temp.a22.get_mpz_t(), a22.get_mpz_t(), s.a22.get_mpz_t());
-    mpz_addmul(temp.a22.get_mpz_t(), a23.get_mpz_t(), s.a32.get_mpz_t());
+    mpz_mul(this->a23.get_mpz_t(), s1.a21.get_mpz_t(), s2.a13.get_mpz_t());
+    mpz_addmul(this->a23.get_mpz_t(), s1.a22.get_mpz_t(), s2.a23.get_mpz_t());
+    mpz_addmul(this->a23.get_mpz_t(), s1.a23.get_mpz_t(), s2.a33.get_mpz_t());
 
-    mpz_mul(temp.a23.get_mpz_t(), a21.get_mpz_t(), s.a13.get_mpz_t());
-    mpz_addmul(temp.a23.get_mpz_t(), a22.get_mpz_t(), s.a23.get_mpz_t());
-    mpz_addmul(temp.a23.get_mpz_t(), a23.get_mpz_t(), s.a33.get_mpz_t());
+    mpz_mul(this->a31.get_mpz_t(), s1.a31.get_mpz_t(), s2.a11.get_mpz_t());
+    mpz_addmul(this->a31.get_mpz_t(), s1.a32.get_mpz_t(), s2.a21.get_mpz_t());
+    mpz_addmul(this->a31.get_mpz_t(), s1.a33.get_mpz_t(), s2.a31.get_mpz_t());
 
-    mpz_mul(temp.a31.get_mpz_t(), a31.get_mpz_t(), s.a11.get_mpz_t());
-    mpz_addmul(temp.a31.get_mpz_t(), a32.get_mpz_t(), s.a21.get_mpz_t());
-    mpz_addmul(temp.a31.get_mpz_t(), a33.get_mpz_t(), s.a31.get_mpz_t());
+    mpz_mul(this->a32.get_mpz_t(), s1.a31.get_mpz_t(), s2.a12.get_mpz_t());
+    mpz_addmul(this->a32.get_mpz_t(), s1.a32.get_mpz_t(), s2.a22.get_mpz_t());
+    mpz_addmul(this->a32.get_mpz_t(), s1.a33.get_mpz_t(), s2.a32.get_mpz_t());
 
-    mpz_mul(temp.a32.get_mpz_t(), a31.get_mpz_t(), s.a12.get_mpz_t());
-    mpz_addmul(temp.a32.get_mpz_t(), a32.get_mpz_t(), s.a22.get_mpz_t());
-    mpz_addmul(temp.a32.get_mpz_t(), a33.get_mpz_t(), s.a32.get_mpz_t());
-
-    mpz_mul(temp.a33.get_mpz_t(), a31.get_mpz_t(), s.a13.get_mpz_t());
-    mpz_addmul(temp.a33.get_mpz_t(), a32.get_mpz_t(), s.a23.get_mpz_t());
-    mpz_addmul(temp.a33.get_mpz_t(), a33.get_mpz_t(), s.a33.get_mpz_t());
-
-    return temp;
+    mpz_mul(this->a33.get_mpz_t(), s1.a31.get_mpz_t(), s2.a13.get_mpz_t());
+    mpz_addmul(this->a33.get_mpz_t(), s1.a32.get_mpz_t(), s2.a23.get_mpz_t());
+    mpz_addmul(this->a33.get_mpz_t(), s1.a33.get_mpz_t(), s2.a33.get_mpz_t());
 }
 
 template<>
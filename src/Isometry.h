@@ -3,6 +3,222 @@
 
 #include "birch.h"
 
+// The proper automorphisms of the reduced forms on each part of the boundary
+// of the Eisenstein reduction domain, other than the identity, given by the
+// entries of their matrices. The automorphisms of the n-th group are the rows
+// from AUTOMORPHISM_OFFSETS[n] up to AUTOMORPHISM_OFFSETS[n+1]. These are
+// expanded into isometries over R only when they are first used.
+constexpr int AUTOMORPHISM_GROUPS = 42;
+
+constexpr Z16 AUTOMORPHISM_OFFSETS[AUTOMORPHISM_GROUPS+1] = {
+      0,   7,  10,  11,  12,  13,  24,  27,  28,  35,  38,
+     41,  42,  53,  56,  57,  80,  87,  90,  95,  96, 119,
+    142, 147, 154, 157, 162, 163, 170, 173, 176, 179, 186,
+    187, 190, 191, 192, 193, 194, 195, 198, 199, 199
+};
+
+constexpr Z16 AUTOMORPHISM_ENTRIES[][9] = {
+    { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
+    { -1, -1,  0,  0,  1,  0,  0,  0, -1 },
+    { -1,  0, -1,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    {  1,  0,  1,  0,  0, -1,  0,  1,  0 },
+    {  1,  1,  0,  0,  0,  1,  0, -1,  0 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    { -1, -1,  0,  0,  1,  0,  0,  0, -1 },
+    { -1,  0, -1,  0, -1,  0,  0,  0,  1 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    { -1, -1,  0,  0,  1,  0,  0,  0, -1 },
+    { -1,  0, -1,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0, -1, -1,  0,  0,  1 },
+    { -1,  0,  0, -1,  1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  1,  0, -1,  0,  0,  0,  0,  1 },
+    { -1,  1,  0,  0,  1,  0,  0,  0, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  0,  1, -1,  0,  0,  0,  1 },
+    {  0,  1,  0, -1,  1,  0,  0,  0,  1 },
+    {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
+    {  1, -1,  0,  0, -1,  0,  0,  0, -1 },
+    {  1, -1,  0,  1,  0,  0,  0,  0,  1 },
+    {  1,  0,  0,  1, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  1,  0,  0,  1,  0,  0,  0, -1 },
+    {  1, -1,  0,  0, -1,  0,  0,  0, -1 },
+    {  1, -1,  0,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  1,  1,  0,  0,  0,  0,  1 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
+    {  0,  1,  0, -1,  0,  1,  0,  0,  1 },
+    {  1,  0, -1,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    {  1,  0, -1,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
+    { -1,  0,  1,  0, -1,  0,  0,  0,  1 },
+    {  1,  0, -1,  0, -1,  0,  0,  0, -1 },
+    {  1,  0, -1,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0, -1,  0,  0, -1,  1 },
+    { -1,  0,  0,  0, -1,  1,  0,  0,  1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
+    { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
+    { -1,  0,  0,  0,  1,  0,  0,  1, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  1,  0, -1,  0 },
+    {  1,  0,  0,  0,  0, -1,  0,  1, -1 },
+    {  1,  0,  0,  0,  0,  1,  0, -1,  1 },
+    {  1,  0,  0,  0,  1, -1,  0,  1,  0 },
+    { -1,  0,  0,  0, -1,  1,  0,  0,  1 },
+    { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
+    { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  1, -1,  1,  0, -1,  0,  0 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    { -1,  1,  0, -1,  0,  0, -1,  0,  1 },
+    { -1,  1,  0,  0,  1,  0,  0,  1, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  0,  1, -1,  0,  0, -1,  1 },
+    {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
+    {  0, -1,  1,  0,  0,  1, -1,  0,  1 },
+    {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
+    {  0,  0, -1,  0,  1, -1,  1,  0, -1 },
+    {  0,  0,  1, -1,  0,  1,  0, -1,  1 },
+    {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
+    {  0,  1, -1, -1,  1,  0,  0,  1,  0 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
+    {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
+    {  0,  1,  0,  0,  1, -1, -1,  1,  0 },
+    {  1, -1,  0,  0, -1,  1,  0, -1,  0 },
+    {  1, -1,  0,  1,  0, -1,  1,  0,  0 },
+    {  1,  0, -1,  0,  0, -1,  0,  1, -1 },
+    {  1,  0, -1,  1,  0,  0,  1, -1,  0 },
+    {  1,  0,  0,  1, -1,  0,  1,  0, -1 },
+    { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
+    {  0,  1,  0,  0,  1, -1, -1,  1,  0 },
+    {  1,  0, -1,  1,  0,  0,  1, -1,  0 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    { -1,  1,  0,  0,  1,  0,  0,  1, -1 },
+    {  1, -1,  0,  0, -1,  1,  0, -1,  0 },
+    {  1,  0, -1,  0,  0, -1,  0,  1, -1 },
+    { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
+    { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  0,  0,  0, -1,  1,  0,  0 },
+    {  0, -1,  0,  0,  0,  1, -1,  0,  0 },
+    {  0, -1,  0,  1,  0,  0,  0,  0,  1 },
+    {  0,  0, -1, -1,  0,  0,  0,  1,  0 },
+    {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
+    {  0,  0, -1,  0,  1,  0,  1,  0,  0 },
+    {  0,  0, -1,  1,  0,  0,  0, -1,  0 },
+    {  0,  0,  1, -1,  0,  0,  0, -1,  0 },
+    {  0,  0,  1,  0, -1,  0,  1,  0,  0 },
+    {  0,  0,  1,  0,  1,  0, -1,  0,  0 },
+    {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
+    {  0,  1,  0, -1,  0,  0,  0,  0,  1 },
+    {  0,  1,  0,  0,  0, -1, -1,  0,  0 },
+    {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
+    {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    {  1,  0,  0,  0,  0, -1,  0,  1,  0 },
+    {  1,  0,  0,  0,  0,  1,  0, -1,  0 },
+    { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
+    { -1, -1, -1,  0,  1,  0,  1,  0,  0 },
+    { -1, -1, -1,  1,  0,  0,  0,  0,  1 },
+    { -1,  0,  0,  0, -1,  0,  1,  1,  1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  0,  1,  1,  1,  0,  0, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  0,  0,  0, -1,  1,  1,  1 },
+    {  0, -1,  0,  1,  1,  1, -1,  0,  0 },
+    {  0,  0, -1, -1,  0,  0,  1,  1,  1 },
+    {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
+    {  0,  0, -1,  1,  1,  1,  0, -1,  0 },
+    {  0,  0,  1, -1, -1, -1,  1,  0,  0 },
+    {  0,  0,  1,  0,  1,  0, -1, -1, -1 },
+    {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
+    {  0,  1,  0, -1, -1, -1,  0,  0,  1 },
+    {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
+    {  0,  1,  0,  1,  0,  0, -1, -1, -1 },
+    {  1,  0,  0, -1, -1, -1,  0,  1,  0 },
+    {  1,  0,  0,  0,  0,  1, -1, -1, -1 },
+    {  1,  1,  1, -1,  0,  0,  0, -1,  0 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    {  1,  1,  1,  0,  0, -1, -1,  0,  0 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
+    {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
+    {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0, -1,  0,  1,  0,  0,  0,  0,  1 },
+    {  0,  1,  0, -1,  0,  0,  0,  0,  1 },
+    {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
+    { -1, -1, -1,  1,  0,  0,  0,  0,  1 },
+    { -1,  0,  0,  1,  1,  1,  0,  0, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    {  0,  1,  0, -1, -1, -1,  0,  0,  1 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
+    { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    {  1,  0,  0,  0,  0, -1,  0,  1,  0 },
+    {  1,  0,  0,  0,  0,  1,  0, -1,  0 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
+    {  0, -1,  1,  0,  0,  1, -1,  0,  1 },
+    {  0,  1, -1, -1,  1,  0,  0,  1,  0 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
+    {  1,  0,  0,  1, -1,  0,  1,  0, -1 },
+    { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
+    { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
+    {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
+    { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
+    {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
+    {  0,  1, -1,  1,  0, -1,  0,  0, -1 }
+};
+
 template<typename R>
 class Isometry
 {
@@ -30,18 +246,25 @@ public:
         this->a31 = 0; this->a32 = 0; this->a33 = 1;
     }
 
+    // Sets this isometry to the adjugate of s divided by p. The isometry s
+    // must not be this isometry.
+    void set_inverse(const Isometry<R>& s, const R& p)
+    {
+        this->a11 = (s.a22 * s.a33 - s.a23 * s.a32) / p;
+        this->a12 = (s.a13 * s.a32 - s.a12 * s.a33) / p;
+        this->a13 = (s.a12 * s.a23 - s.a13 * s.a22) / p;
+        this->a21 = (s.a23 * s.a31 - s.a21 * s.a33) / p;
+        this->a22 = (s.a11 * s.a33 - s.a13 * s.a31) / p;
+        this->a23 = (s.a13 * s.a21 - s.a11 * s.a23) / p;
+        this->a31 = (s.a21 * s.a32 - s.a22 * s.a31) / p;
+        this->a32 = (s.a12 * s.a31 - s.a11 * s.a32) / p;
+        this->a33 = (s.a11 * s.a22 - s.a12 * s.a21) / p;
+    }
+
     Isometry<R> inverse(const R& p) const
     {
         Isometry<R> temp;
-        temp.a11 = (this->a22 * this->a33 - this->a23 * this->a32) / p;
-        temp.a12 = (this->a13 * this->a32 - this->a12 * this->a33) / p;
-        temp.a13 = (this->a12 * this->a23 - this->a13 * this->a22) / p;
-        temp.a21 = (this->a23 * this->a31 - this->a21 * this->a33) / p;
-        temp.a22 = (this->a11 * this->a33 - this->a13 * this->a31) / p;
-        temp.a23 = (this->a13 * this->a21 - this->a11 * this->a23) / p;
-        temp.a31 = (this->a21 * this->a32 - this->a22 * this->a31) / p;
-        temp.a32 = (this->a12 * this->a31 - this->a11 * this->a32) / p;
-        temp.a33 = (this->a11 * this->a22 - this->a12 * this->a21) / p;
+        temp.set_inverse(*this, p);
         return temp;
     }
 
@@ -60,18 +283,25 @@ public:
         return temp;
     }
 
+    // Sets this isometry to the product s1*s2. Neither s1 nor s2 may be
+    // this isometry.
+    void set_product(const Isometry<R>& s1, const Isometry<R>& s2)
+    {
+        this->a11 = s1.a11*s2.a11 + s1.a12*s2.a21 + s1.a13*s2.a31;
+        this->a12 = s1.a11*s2.a12 + s1.a12*s2.a22 + s1.a13*s2.a32;
+        this->a13 = s1.a11*s2.a13 + s1.a12*s2.a23 + s1.a13*s2.a33;
+        this->a21 = s1.a21*s2.a11 + s1.a22*s2.a21 + s1.a23*s2.a31;
+        this->a22 = s1.a21*s2.a12 + s1.a22*s2.a22 + s1.a23*s2.a32;
+        this->a23 = s1.a21*s2.a13 + s1.a22*s2.a23 + s1.a23*s2.a33;
+        this->a31 = s1.a31*s2.a11 + s1.a32*s2.a21 + s1.a33*s2.a31;
+        this->a32 = s1.a31*s2.a12 + s1.a32*s2.a22 + s1.a33*s2.a32;
+        this->a33 = s1.a31*s2.a13 + s1.a32*s2.a23 + s1.a33*s2.a33;
+    }
+
     Isometry<R> operator*(const Isometry<R>& s) const
     {
         Isometry<R> temp;
-        temp.a11 = this->a11*s.a11 + this->a12*s.a21 + this->a13*s.a31;
-        temp.a12 = this->a11*s.a12 + this->a12*s.a22 + this->a13*s.a32;
-        temp.a13 = this->a11*s.a13 + this->a12*s.a23 + this->a13*s.a33;
-        temp.a21 = this->a21*s.a11 + this->a22*s.a21 + this->a23*s.a31;
-        temp.a22 = this->a21*s.a12 + this->a22*s.a22 + this->a23*s.a32;
-        temp.a23 = this->a21*s.a13 + this->a22*s.a23 + this->a23*s.a33;
-        temp.a31 = this->a31*s.a11 + this->a32*s.a21 + this->a33*s.a31;
-        temp.a32 = this->a31*s.a12 + this->a32*s.a22 + this->a33*s.a32;
-        temp.a33 = this->a31*s.a13 + this->a32*s.a23 + this->a33*s.a33;
+        temp.set_product(*this, s);
         return temp;
     }
 
@@ -349,308 +579,42 @@ public:
         return os;
     }
 
-    static std::vector<std::vector<Isometry<R>>> automorphisms;
+    // The automorphisms of the n-th group, see AUTOMORPHISM_ENTRIES.
+    static const std::vector<Isometry<R>>& automorphisms(int n)
+    {
+        static const std::vector<std::vector<Isometry<R>>> groups = Isometry<R>::expand_automorphisms();
+        return groups[n];
+    }
 
     R a11, a12, a13;
     R a21, a22, a23;
     R a31, a32, a33;
-};
 
-template<typename R>
-std::vector<std::vector<Isometry<R>>> Isometry<R>::automorphisms = {
-    {
-        { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
-        { -1, -1,  0,  0,  1,  0,  0,  0, -1 },
-        { -1,  0, -1,  0, -1,  0,  0,  0,  1 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        {  1,  0,  1,  0,  0, -1,  0,  1,  0 },
-        {  1,  1,  0,  0,  0,  1,  0, -1,  0 },
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1, -1,  0,  0,  1,  0,  0,  0, -1 },
-        { -1,  0, -1,  0, -1,  0,  0,  0,  1 },
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1, -1,  0,  0,  1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0, -1,  0, -1,  0,  0,  0,  1 }
-    },
-    {
-        { -1,  0,  0,  0, -1, -1,  0,  0,  1 }
-    },
-    {
-        { -1,  0,  0, -1,  1,  0,  0,  0, -1 },
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        { -1,  1,  0, -1,  0,  0,  0,  0,  1 },
-        { -1,  1,  0,  0,  1,  0,  0,  0, -1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  0,  1, -1,  0,  0,  0,  1 },
-        {  0,  1,  0, -1,  1,  0,  0,  0,  1 },
-        {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
-        {  1, -1,  0,  0, -1,  0,  0,  0, -1 },
-        {  1, -1,  0,  1,  0,  0,  0,  0,  1 },
-        {  1,  0,  0,  1, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        { -1,  1,  0,  0,  1,  0,  0,  0, -1 },
-        {  1, -1,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        {  1, -1,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  1,  1,  0,  0,  0,  0,  1 },
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
-        {  0,  1,  0, -1,  0,  1,  0,  0,  1 },
-        {  1,  0, -1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
-        {  1,  0, -1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
-        { -1,  0,  1,  0, -1,  0,  0,  0,  1 },
-        {  1,  0, -1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        {  1,  0, -1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0, -1,  1 },
-        { -1,  0,  0,  0, -1,  1,  0,  0,  1 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
-        { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
-        { -1,  0,  0,  0,  1,  0,  0,  1, -1 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
-        {  1,  0,  0,  0, -1,  1,  0, -1,  0 },
-        {  1,  0,  0,  0,  0, -1,  0,  1, -1 },
-        {  1,  0,  0,  0,  0,  1,  0, -1,  1 },
-        {  1,  0,  0,  0,  1, -1,  0,  1,  0 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  1,  0,  0,  1 },
-        { -1,  0,  0,  0,  1, -1,  0,  0, -1 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0,  1, -1,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  1, -1,  1,  0, -1,  0,  0 },
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
-        { -1,  1,  0, -1,  0,  0, -1,  0,  1 },
-        { -1,  1,  0,  0,  1,  0,  0,  1, -1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  0,  1, -1,  0,  0, -1,  1 },
-        {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
-        {  0, -1,  1,  0,  0,  1, -1,  0,  1 },
-        {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
-        {  0,  0, -1,  0,  1, -1,  1,  0, -1 },
-        {  0,  0,  1, -1,  0,  1,  0, -1,  1 },
-        {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
-        {  0,  1, -1, -1,  1,  0,  0,  1,  0 },
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
-        {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
-        {  0,  1,  0,  0,  1, -1, -1,  1,  0 },
-        {  1, -1,  0,  0, -1,  1,  0, -1,  0 },
-        {  1, -1,  0,  1,  0, -1,  1,  0,  0 },
-        {  1,  0, -1,  0,  0, -1,  0,  1, -1 },
-        {  1,  0, -1,  1,  0,  0,  1, -1,  0 },
-        {  1,  0,  0,  1, -1,  0,  1,  0, -1 }
-    },
-    {
-        { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
-        {  0,  1,  0,  0,  1, -1, -1,  1,  0 },
-        {  1,  0, -1,  1,  0,  0,  1, -1,  0 }
-    },
-    {
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 },
-        { -1,  1,  0,  0,  1,  0,  0,  1, -1 },
-        {  1, -1,  0,  0, -1,  1,  0, -1,  0 },
-        {  1,  0, -1,  0,  0, -1,  0,  1, -1 }
-    },
-    {
-        { -1,  0,  1,  0, -1,  1,  0,  0,  1 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
-        { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  0,  0,  0, -1,  1,  0,  0 },
-        {  0, -1,  0,  0,  0,  1, -1,  0,  0 },
-        {  0, -1,  0,  1,  0,  0,  0,  0,  1 },
-        {  0,  0, -1, -1,  0,  0,  0,  1,  0 },
-        {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
-        {  0,  0, -1,  0,  1,  0,  1,  0,  0 },
-        {  0,  0, -1,  1,  0,  0,  0, -1,  0 },
-        {  0,  0,  1, -1,  0,  0,  0, -1,  0 },
-        {  0,  0,  1,  0, -1,  0,  1,  0,  0 },
-        {  0,  0,  1,  0,  1,  0, -1,  0,  0 },
-        {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
-        {  0,  1,  0, -1,  0,  0,  0,  0,  1 },
-        {  0,  1,  0,  0,  0, -1, -1,  0,  0 },
-        {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
-        {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
-        {  1,  0,  0,  0,  0, -1,  0,  1,  0 },
-        {  1,  0,  0,  0,  0,  1,  0, -1,  0 }
-    },
-    {
-        { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
-        { -1, -1, -1,  0,  1,  0,  1,  0,  0 },
-        { -1, -1, -1,  1,  0,  0,  0,  0,  1 },
-        { -1,  0,  0,  0, -1,  0,  1,  1,  1 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  0,  1,  1,  1,  0,  0, -1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  0,  0,  0, -1,  1,  1,  1 },
-        {  0, -1,  0,  1,  1,  1, -1,  0,  0 },
-        {  0,  0, -1, -1,  0,  0,  1,  1,  1 },
-        {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
-        {  0,  0, -1,  1,  1,  1,  0, -1,  0 },
-        {  0,  0,  1, -1, -1, -1,  1,  0,  0 },
-        {  0,  0,  1,  0,  1,  0, -1, -1, -1 },
-        {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
-        {  0,  1,  0, -1, -1, -1,  0,  0,  1 },
-        {  0,  1,  0,  0,  0,  1,  1,  0,  0 },
-        {  0,  1,  0,  1,  0,  0, -1, -1, -1 },
-        {  1,  0,  0, -1, -1, -1,  0,  1,  0 },
-        {  1,  0,  0,  0,  0,  1, -1, -1, -1 },
-        {  1,  1,  1, -1,  0,  0,  0, -1,  0 },
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 },
-        {  1,  1,  1,  0,  0, -1, -1,  0,  0 }
-    },
-    {
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0,  0, -1,  0, -1,  0, -1,  0,  0 },
-        {  0,  0,  1,  1,  0,  0,  0,  1,  0 },
-        {  0,  1,  0,  0,  0,  1,  1,  0,  0 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0, -1,  0,  1,  0,  0,  0,  0,  1 },
-        {  0,  1,  0, -1,  0,  0,  0,  0,  1 },
-        {  0,  1,  0,  1,  0,  0,  0,  0, -1 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0,  1,  0,  1,  0,  0,  0,  0, -1 }
-    },
-    {
-        { -1, -1, -1,  1,  0,  0,  0,  0,  1 },
-        { -1,  0,  0,  1,  1,  1,  0,  0, -1 },
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 },
-        {  0,  1,  0, -1, -1, -1,  0,  0,  1 },
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        {  0, -1,  0, -1,  0,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
-        { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 },
-        {  1,  0,  0,  0,  0, -1,  0,  1,  0 },
-        {  1,  0,  0,  0,  0,  1,  0, -1,  0 }
-    },
-    {
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        { -1,  0,  0,  0,  0,  1,  0,  1,  0 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1, -1, -1,  0,  0,  1,  0,  1,  0 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 },
-        {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
-        {  0, -1,  1,  0,  0,  1, -1,  0,  1 },
-        {  0,  1, -1, -1,  1,  0,  0,  1,  0 },
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 },
-        {  1,  0,  0,  1, -1,  0,  1,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0,  0, -1,  0, -1,  0 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 },
-        { -1,  0,  0,  0,  1,  0,  0,  0, -1 },
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0,  0, -1,  0,  0,  0,  1 }
-    },
-    {
-        { -1,  0,  0,  0,  1,  0,  0,  0, -1 }
-    },
-    {
-        {  1,  0,  0,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        {  1,  1,  1,  0, -1,  0,  0,  0, -1 }
-    },
-    {
-        { -1,  0,  0, -1,  0,  1, -1,  1,  0 },
-        {  0, -1,  1,  0, -1,  0,  1, -1,  0 },
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 }
-    },
-    {
-        {  0,  1, -1,  1,  0, -1,  0,  0, -1 }
-    },
-    {
+private:
+    static std::vector<std::vector<Isometry<R>>> expand_automorphisms(void)
+    {
+        std::vector<std::vector<Isometry<R>>> groups(AUTOMORPHISM_GROUPS);
+        for (int n=0; n<AUTOMORPHISM_GROUPS; n++)
+        {
+            for (int k=AUTOMORPHISM_OFFSETS[n]; k<AUTOMORPHISM_OFFSETS[n+1]; k++)
+            {
+                const Z16 *e = AUTOMORPHISM_ENTRIES[k];
+                groups[n].emplace_back(e[0], e[1], e[2], e[3], e[4], e[5], e[6], e[7], e[8]);
+            }
+        }
+        return groups;
     }
 };
 
+
 template<>
 void Z_Isometry::set_identity(void);
 
 template<>
-Z_Isometry Z_Isometry::inverse(const Z& p) const;
+void Z_Isometry::set_inverse(const Z_Isometry& s, const Z& p);
 
 template<>
-Z_Isometry Z_Isometry::operator*(const Z_Isometry& s) const;
+void Z_Isometry::set_product(const Z_Isometry& s1, const Z_Isometry& s2);
 
 template<>
 void Z_Isometry::A101011001();
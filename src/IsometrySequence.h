@@ -23,18 +23,24 @@ public:
         this->prime = birch_util::convert_Integer<T,R>(p);
         this->primeT = p;
 
-        if (this->prime == 2)
-            this->GF = std::make_shared<W16_F2>(2, genus->seed());
-        else
-            this->GF = std::make_shared<Fp<R,S>>(prime, genus->seed(), true);
-
         this->genus_ = genus;
 
         this->current_rep = 0;
         this->current_neighbor = 0;
 
-        const GenusRep<T>& cur = this->genus_->representative(this->current_rep);
-        this->manager_ = std::make_shared<NeighborManager<R,S,T>>(cur.q, this->GF);
+        // The field of two elements has its own arithmetic type, so we keep
+        // a neighbor manager for each field type and use only one of them.
+        const QuadForm<T>& cur = this->genus_->form(this->current_rep);
+        if (this->prime == 2)
+        {
+            this->GF2 = std::make_shared<F2<R,S>>(2, genus->seed());
+            this->manager2_ = std::make_shared<NeighborManager<R,S,T,F2<R,S>>>(cur, this->GF2);
+        }
+        else
+        {
+            this->GF = std::make_shared<Fp<R,S>>(prime, genus->seed(), true);
+            this->manager_ = std::make_shared<NeighborManager<R,S,T>>(cur, this->GF);
+        }
     }
 
     bool done() const
@@ -54,19 +60,21 @@ public:
 
         // We assume that the current state is valid, and so we proceed by
         // computing the desired isometry.
-        const GenusRep<T>& cur = this->genus_->representative(current_rep);
-        GenusRep<T> foo = this->manager_->get_reduced_neighbor_rep(current_neighbor);
+        GenusRep<T>& foo = this->foo_;
+        if (this->prime == 2)
+            this->manager2_->get_reduced_neighbor_rep(current_neighbor, foo);
+        else
+            this->manager_->get_reduced_neighbor_rep(current_neighbor, foo);
         size_t r = this->genus_->indexof(foo);
-        const GenusRep<T>& rep = this->genus_->representative(r);
 
         // Set the isometry.
-        isometry_data.isometry = cur.s * foo.s;
-        isometry_data.isometry = isometry_data.isometry * rep.sinv;
+        this->prod_.set_product(this->genus_->isometry(current_rep), foo.s);
+        isometry_data.isometry.set_product(this->prod_, this->genus_->inverse_isometry(r));
 
         // Set the denominator.
         isometry_data.denominator = this->primeT;
-        isometry_data.denominator *= birch_util::my_pow(cur.es);
-        isometry_data.denominator *= birch_util::my_pow(rep.es);
+        isometry_data.denominator *= this->genus_->scalar(current_rep);
+        isometry_data.denominator *= this->genus_->scalar(r);
 
         // Set the parent rep and the class of its neighbor.
         isometry_data.src = this->current_rep;
@@ -83,8 +91,11 @@ public:
             if (!this->done())
             {
                 // Update the neighbor manager if we've rolled over.
-                const GenusRep<T>& cur = this->genus_->representative(this->current_rep);
-                *this->manager_ = NeighborManager<R,S,T>(cur.q, this->GF);
+                const QuadForm<T>& cur = this->genus_->form(this->current_rep);
+                if (this->prime == 2)
+                    *this->manager2_ = NeighborManager<R,S,T,F2<R,S>>(cur, this->GF2);
+                else
+                    *this->manager_ = NeighborManager<R,S,T>(cur, this->GF);
             }
         }
 
@@ -94,7 +105,13 @@ public:
 private:
     std::shared_ptr<Genus<T>> genus_;
     std::shared_ptr<NeighborManager<R,S,T>> manager_;
+    std::shared_ptr<NeighborManager<R,S,T,F2<R,S>>> manager2_;
     std::shared_ptr<Fp<R,S>> GF;
+    std::shared_ptr<F2<R,S>> GF2;
+    // Storage for the current neighbor and the partial product of the
+    // composite isometry, reused for every neighbor.
+    GenusRep<T> foo_;
+    Isometry<T> prod_;
     R prime;
     T primeT;
     size_t current_rep;
@@ -2,6 +2,7 @@
 
 template class Math<Z>;
 template class Math<Z64>;
+template class Math<SmallZ>;
 
 const std::vector<int> hilbert_lut_odd = { 1, 1, 1, 1,
                                            1, 1,-1,-1,
@@ -17,9 +18,134 @@ const std::vector<int> hilbert_lut_p2 = { 1, 1, 1, 1, 1, 1, 1, 1,
                                           1,-1,-1, 1,-1, 1, 1,-1,
                                           1, 1,-1,-1, 1, 1,-1,-1 };
 
+// Computes the inverse of a modulo an odd prime p with the binary extended
+// Euclidean algorithm. The invariants are x1*a = u and x2*a = v modulo p, and
+// all intermediate values stay below p, so that nothing overflows.
+template<typename R>
+static R binary_inverse(R a, R p)
+{
+    a %= p;
+    if (a == 0) return 0;
+
+    R u = a;
+    R v = p;
+    R x1 = 1;
+    R x2 = 0;
+    R half = (p >> 1) + 1;
+
+    while (u != 1 && v != 1)
+    {
+        while (!(u & 1))
+        {
+            u >>= 1;
+            x1 = (x1 & 1) ? (x1 >> 1) + half : (x1 >> 1);
+        }
+
+        while (!(v & 1))
+        {
+            v >>= 1;
+            x2 = (x2 & 1) ? (x2 >> 1) + half : (x2 >> 1);
+        }
+
+        if (u >= v)
+        {
+            u -= v;
+            x1 = (x1 >= x2) ? x1 - x2 : x1 + (p - x2);
+        }
+        else
+        {
+            v -= u;
+            x2 = (x2 >= x1) ? x2 - x1 : x2 + (p - x1);
+        }
+    }
+
+    return (u == 1) ? x1 : x2;
+}
+
+// Computes the Jacobi symbol (a/n) with the binary algorithm, using
+// quadratic reciprocity and the second supplementary law.
+template<typename R>
+static int binary_jacobi(R a, R n)
+{
+    int t = 1;
+    a %= n;
+
+    while (a != 0)
+    {
+        int zeros = __builtin_ctzll(a);
+        a >>= zeros;
+
+        R r = n & 0x7;
+        if ((zeros & 1) && (r == 3 || r == 5)) t = -t;
+
+        std::swap(a, n);
+        if ((a & 0x3) == 3 && (n & 0x3) == 3) t = -t;
+        a %= n;
+    }
+
+    return (n == 1) ? t : 0;
+}
+
+template<>
+W16 W16_Math::inverse(W16 a, const W16& p)
+{
+    return binary_inverse(a, p);
+}
+
+template<>
+W32 W32_Math::inverse(W32 a, const W32& p)
+{
+    return binary_inverse(a, p);
+}
+
+template<>
+W64 W64_Math::inverse(W64 a, const W64& p)
+{
+    return binary_inverse(a, p);
+}
+
+template<>
+Z64 Z64_Math::inverse(Z64 a, const Z64& p)
+{
+    a %= p;
+    if (a < 0) a += p;
+    return binary_inverse<W64>(a, p);
+}
+
+template<>
+int W16_Math::jacobi(W16 a, const W16& n)
+{
+    return binary_jacobi(a, n);
+}
+
+template<>
+int W32_Math::jacobi(W32 a, const W32& n)
+{
+    return binary_jacobi(a, n);
+}
+
+template<>
+int W64_Math::jacobi(W64 a, const W64& n)
+{
+    return binary_jacobi(a, n);
+}
+
+template<>
+int Z64_Math::jacobi(Z64 a, const Z64& n)
+{
+    a %= n;
+    if (a < 0) a += n;
+    return binary_jacobi<W64>(a, n);
+}
+
 template<>
 int Z_Math::hilbert_symbol(Z a, Z b, const Z& p)
 {
+    if (a.fits_slong_p() && b.fits_slong_p() && p.fits_slong_p())
+    {
+        return Z64_Math::hilbert_symbol(a.get_si(), b.get_si(), p.get_si());
+    }
+
     int a_val = 0;
     while (a % p == 0)
     {
@@ -59,5 +185,49 @@ int Z_Math::hilbert_symbol(Z a, Z b, const Z& p)
 template<>
 int Z64_Math::hilbert_symbol(Z64 a, Z64 b, const Z64& p)
 {
-    return Z_Math::hilbert_symbol(a, b, p);
+    int a_val = 0;
+    while (a % p == 0)
+    {
+        ++a_val;
+        a /= p;
+    }
+
+    int b_val = 0;
+    while (b % p == 0)
+    {
+        ++b_val;
+        b /= p;
+    }
+
+    if (p == 2)
+    {
+        int aa = ((a%8) >> 1) & 0x3;
+        int bb = ((b%8) >> 1) & 0x3;
+        int index = ((a_val&0x1)<<5) | (aa << 3) | ((b_val&0x1)<<2) | bb;
+        return hilbert_lut_p2[index];
+    }
+
+    int a_notsqr = Z64_Math::jacobi(a, p) == -1;
+    int b_notsqr = Z64_Math::jacobi(b, p) == -1;
+
+    int index = ((a_val&0x1)<<3) | (a_notsqr<<2) | ((b_val&0x1)<<1) | b_notsqr;
+    if (((index & 0xa) == 0xa) && ((p%4) == 0x3))
+    {
+        return -hilbert_lut_odd[index];
+    }
+    else
+    {
+        return hilbert_lut_odd[index];
+    }
+}
+
+template<>
+int SmallZ_Math::hilbert_symbol(SmallZ a, SmallZ b, const SmallZ& p)
+{
+    if (a.is_small() && b.is_small() && p.is_small())
+    {
+        return Z64_Math::hilbert_symbol(a.get_si(), b.get_si(), p.get_si());
+    }
+
+    return Z_Math::hilbert_symbol(a.get_z(), b.get_z(), p.get_z());
 }
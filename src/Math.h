@@ -8,6 +8,45 @@ class Math
 {
 public:
     static int hilbert_symbol(R a, R b, const R& p);
+
+    // The inverse of a modulo an odd prime p, or zero if p divides a.
+    static R inverse(R a, const R& p);
+
+    // The Jacobi symbol (a/n) for odd positive n.
+    static int jacobi(R a, const R& n);
 };
 
+template<>
+int Z_Math::hilbert_symbol(Z a, Z b, const Z& p);
+
+template<>
+int Z64_Math::hilbert_symbol(Z64 a, Z64 b, const Z64& p);
+
+template<>
+int SmallZ_Math::hilbert_symbol(SmallZ a, SmallZ b, const SmallZ& p);
+
+template<>
+W16 W16_Math::inverse(W16 a, const W16& p);
+
+template<>
+W32 W32_Math::inverse(W32 a, const W32& p);
+
+template<>
+W64 W64_Math::inverse(W64 a, const W64& p);
+
+template<>
+Z64 Z64_Math::inverse(Z64 a, const Z64& p);
+
+template<>
+int W16_Math::jacobi(W16 a, const W16& n);
+
+template<>
+int W32_Math::jacobi(W32 a, const W32& n);
+
+template<>
+int W64_Math::jacobi(W64 a, const W64& n);
+
+template<>
+int Z64_Math::jacobi(Z64 a, const Z64& n);
+
 #endif // __MATH_H_
@@ -0,0 +1,293 @@
+#include "birch.h"
+#include "Genus.h"
+#include "NeighborManager.h"
+#include "Scratch.h"
+
+// Centers a residue modulo p, so that it lies in the interval (-p/2, p/2].
+template<typename R>
+static inline Z64 center(R x, R p)
+{
+    return (x > (p>>1)) ? -(Z64)(p - x) : (Z64)x;
+}
+
+// Builds the p-neighbor associated to an isotropic vector with arbitrary
+// precision arithmetic. This follows NeighborManager::build_neighbor step by
+// step, but all temporaries are thread-local mpz variables which are updated
+// in place, so that no heap allocation takes place once their limbs have
+// grown large enough.
+template<typename R, typename F>
+static Z_QuadForm build_neighbor_Z(const Z_QuadForm& q, F& GF,
+                                   const Vector3<R>& vec2, Z_Isometry& s)
+{
+    static thread_local Scratch<12> scratch;
+
+    mpz_ptr aa = scratch.ptr(0);
+    mpz_ptr bb = scratch.ptr(1);
+    mpz_ptr cc = scratch.ptr(2);
+    mpz_ptr ff = scratch.ptr(3);
+    mpz_ptr gg = scratch.ptr(4);
+    mpz_ptr hh = scratch.ptr(5);
+    mpz_ptr s1 = scratch.ptr(6);
+    mpz_ptr s2 = scratch.ptr(7);
+    mpz_ptr p = scratch.ptr(8);
+    mpz_ptr pp = scratch.ptr(9);
+    mpz_ptr temp = scratch.ptr(10);
+    mpz_ptr temp2 = scratch.ptr(11);
+
+    mpz_srcptr a = q.a().get_mpz_t();
+    mpz_srcptr b = q.b().get_mpz_t();
+    mpz_srcptr c = q.c().get_mpz_t();
+    mpz_srcptr f = q.f().get_mpz_t();
+    mpz_srcptr g = q.g().get_mpz_t();
+    mpz_srcptr h = q.h().get_mpz_t();
+
+    R prime = GF.prime();
+    mpz_set_ui(p, prime);
+    mpz_mul(pp, p, p);
+
+    // Convert isotropic vector into the correct domain. Since the centered
+    // coordinates are at most p/2 in absolute value, they fit into 64 bits.
+    R z = GF.mod(vec2.z);
+    Z64 u = center(GF.mod(vec2.x), prime);
+    Z64 v = center(GF.mod(vec2.y), prime);
+
+    if (z == 1)
+    {
+        s.a11 = u; s.a12 = 0; s.a13 = -1;
+        s.a21 = v; s.a22 = 1; s.a23 = 0;
+        s.a31 = 1; s.a32 = 0; s.a33 = 0;
+
+        // temp = au + hv + g, temp2 = au
+        mpz_mul_si(temp2, a, u);
+        mpz_mul_si(temp, h, v);
+        mpz_add(temp, temp, temp2);
+        mpz_add(temp, temp, g);
+
+        // gg = -(temp + au)
+        mpz_add(gg, temp, temp2);
+        mpz_neg(gg, gg);
+
+        // hh = f + hu + 2bv, aa = c + u*temp + v*(bv + f)
+        mpz_mul_si(temp2, b, v);
+        mpz_mul_si(hh, h, u);
+        mpz_add(hh, hh, f);
+        mpz_addmul_ui(hh, temp2, 2);
+
+        mpz_add(aa, temp2, f);
+        mpz_mul_si(aa, aa, v);
+        mpz_mul_si(temp, temp, u);
+        mpz_add(aa, aa, temp);
+        mpz_add(aa, aa, c);
+
+        mpz_set(bb, b);
+        mpz_set(cc, a);
+        mpz_neg(ff, h);
+    }
+    else if (v == 1)
+    {
+        s.a11 = u; s.a12 = 0; s.a13 = 1;
+        s.a21 = 1; s.a22 = 0; s.a23 = 0;
+        s.a31 = 0; s.a32 = 1; s.a33 = 0;
+
+        // temp = au + h, temp2 = au
+        mpz_mul_si(temp2, a, u);
+        mpz_add(temp, temp2, h);
+
+        mpz_mul_si(aa, temp, u);
+        mpz_add(aa, aa, b);
+        mpz_add(gg, temp, temp2);
+        mpz_mul_si(hh, g, u);
+        mpz_add(hh, hh, f);
+
+        mpz_set(bb, c);
+        mpz_set(cc, a);
+        mpz_set(ff, g);
+    }
+    else
+    {
+        s.a11 = 1; s.a12 = 0; s.a13 = 0;
+        s.a21 = 0; s.a22 = 0; s.a23 = -1;
+        s.a31 = 0; s.a32 = 1; s.a33 = 0;
+
+        mpz_set(aa, a);
+        mpz_set(bb, c);
+        mpz_set(cc, b);
+        mpz_neg(ff, f);
+        mpz_neg(gg, h);
+        mpz_set(hh, g);
+    }
+
+    #ifdef DEBUG
+    assert( mpz_divisible_p(aa, p) );
+    #endif
+
+    R gmodp = (R)mpz_fdiv_ui(gg, prime);
+    if (gmodp == 0)
+    {
+        s.A1000010n0();
+
+        mpz_swap(bb, cc);
+        mpz_swap(gg, hh);
+        mpz_neg(hh, hh);
+        mpz_neg(ff, ff);
+
+        gmodp = (R)mpz_fdiv_ui(gg, prime);
+    }
+
+    #ifdef DEBUG
+    assert( gmodp != 0 );
+    #endif
+
+    R ginv = GF.inverse(gmodp) % prime;
+
+    // s1 = (-hh * ginv) % p, centered.
+    mpz_mul_ui(s1, hh, ginv);
+    mpz_neg(s1, s1);
+    mpz_tdiv_r(s1, s1, p);
+    mpz_fdiv_q_2exp(temp, p, 1);
+    mpz_neg(temp, temp);
+    if (mpz_cmp(s1, temp) < 0) mpz_add(s1, s1, p);
+
+    // s2 = (-aa * ginv) % pp, centered.
+    mpz_mul_ui(s2, aa, ginv);
+    mpz_neg(s2, s2);
+    mpz_tdiv_r(s2, s2, pp);
+    mpz_fdiv_q_2exp(temp, pp, 1);
+    mpz_neg(temp, temp);
+    if (mpz_cmp(s2, temp) < 0) mpz_add(s2, s2, pp);
+
+    s.A1000100t1(scratch[6]);
+
+    // bb += s1*(ff + cc*s1), ff += 2*cc*s1, hh += s1*gg
+    mpz_mul(temp, cc, s1);
+    mpz_add(temp2, ff, temp);
+    mpz_addmul(bb, s1, temp2);
+    mpz_addmul_ui(ff, temp, 2);
+    mpz_addmul(hh, s1, gg);
+
+    #ifdef DEBUG
+    assert( mpz_divisible_p(hh, p) );
+    #endif
+
+    s.A100010t01(scratch[7]);
+
+    // aa += s2*(gg + cc*s2), gg += 2*cc*s2, hh += s2*ff
+    mpz_mul(temp, cc, s2);
+    mpz_add(temp2, gg, temp);
+    mpz_addmul(aa, s2, temp2);
+    mpz_addmul_ui(gg, temp, 2);
+    mpz_addmul(hh, s2, ff);
+
+    #ifdef DEBUG
+    assert( mpz_sgn(aa) > 0 );
+    assert( mpz_divisible_p(aa, pp) );
+    assert( mpz_divisible_p(hh, p) );
+    #endif
+
+    s.A1000p000p2(scratch[8], scratch[9]);
+    mpz_divexact(aa, aa, pp);
+    mpz_mul(cc, cc, pp);
+    mpz_mul(ff, ff, p);
+    mpz_divexact(hh, hh, p);
+
+    return Z_QuadForm(scratch[0], scratch[1], scratch[2],
+                      scratch[3], scratch[4], scratch[5]);
+}
+
+// Computes the coordinates of sinv * src / p modulo p, where sinv is the
+// adjugate of the isometry of dst.
+template<typename R>
+static Vector3<R> transform_vector_Z(const Vector3<R>& src, const Z_Isometry& sinv, R p)
+{
+    static thread_local Scratch<3> scratch;
+
+    mpz_ptr x = scratch.ptr(0);
+    mpz_ptr y = scratch.ptr(1);
+    mpz_ptr z = scratch.ptr(2);
+
+    R u = src.x % p;
+    R v = src.y % p;
+    R w = src.z % p;
+
+    mpz_mul_ui(x, sinv.a11.get_mpz_t(), u);
+    mpz_addmul_ui(x, sinv.a12.get_mpz_t(), v);
+    mpz_addmul_ui(x, sinv.a13.get_mpz_t(), w);
+    mpz_mul_ui(y, sinv.a21.get_mpz_t(), u);
+    mpz_addmul_ui(y, sinv.a22.get_mpz_t(), v);
+    mpz_addmul_ui(y, sinv.a23.get_mpz_t(), w);
+    mpz_mul_ui(z, sinv.a31.get_mpz_t(), u);
+    mpz_addmul_ui(z, sinv.a32.get_mpz_t(), v);
+    mpz_addmul_ui(z, sinv.a33.get_mpz_t(), w);
+
+    #ifdef DEBUG
+    assert( mpz_divisible_ui_p(x, p) );
+    assert( mpz_divisible_ui_p(y, p) );
+    assert( mpz_divisible_ui_p(z, p) );
+    #endif
+
+    mpz_divexact_ui(x, x, p);
+    mpz_divexact_ui(y, y, p);
+    mpz_divexact_ui(z, z, p);
+
+    Vector3<R> vec;
+    vec.x = (R)mpz_fdiv_ui(x, p);
+    vec.y = (R)mpz_fdiv_ui(y, p);
+    vec.z = (R)mpz_fdiv_ui(z, p);
+    return vec;
+}
+
+template<>
+Z_QuadForm Z_W16_NeighborManager::build_neighbor(W16_Vector3& vec2, Z_Isometry& s) const
+{
+    return build_neighbor_Z(this->q, *this->GF, vec2, s);
+}
+
+template<>
+Z_QuadForm Z_W32_NeighborManager::build_neighbor(W32_Vector3& vec2, Z_Isometry& s) const
+{
+    return build_neighbor_Z(this->q, *this->GF, vec2, s);
+}
+
+template<>
+Z_QuadForm Z_W64_NeighborManager::build_neighbor(W64_Vector3& vec2, Z_Isometry& s) const
+{
+    return build_neighbor_Z(this->q, *this->GF, vec2, s);
+}
+
+template<>
+Z_QuadForm Z_W16_F2_NeighborManager::build_neighbor(W16_Vector3& vec2, Z_Isometry& s) const
+{
+    return build_neighbor_Z(this->q, *this->GF, vec2, s);
+}
+
+template<>
+W16_Vector3 Z_W16_NeighborManager::transform_vector(const Z_GenusRep& dst, W16_Vector3 src)
+{
+    W16 p = this->GF->prime();
+    this->sinv.set_inverse(dst.s, p);
+    return this->normalize_vector(transform_vector_Z(src, this->sinv, p));
+}
+
+template<>
+W32_Vector3 Z_W32_NeighborManager::transform_vector(const Z_GenusRep& dst, W32_Vector3 src)
+{
+    W32 p = this->GF->prime();
+    this->sinv.set_inverse(dst.s, p);
+    return this->normalize_vector(transform_vector_Z(src, this->sinv, p));
+}
+
+template<>
+W64_Vector3 Z_W64_NeighborManager::transform_vector(const Z_GenusRep& dst, W64_Vector3 src)
+{
+    W64 p = this->GF->prime();
+    this->sinv.set_inverse(dst.s, p);
+    return this->normalize_vector(transform_vector_Z(src, this->sinv, p));
+}
+
+template<>
+W16_Vector3 Z_W16_F2_NeighborManager::transform_vector(const Z_GenusRep& dst, W16_Vector3 src)
+{
+    W16 p = this->GF->prime();
+    this->sinv.set_inverse(dst.s, p);
+    return this->normalize_vector(transform_vector_Z(src, this->sinv, p));
+}
@@ -6,16 +6,16 @@
 #include "Isometry.h"
 #include "Fp.h"
 
-template<typename R, typename S, typename T>
+template<typename R, typename S, typename T, typename F>
 class NeighborManager
 {
 public:
-    NeighborManager(const QuadForm<T>& q, std::shared_ptr<Fp<R,S>> GF)
+    NeighborManager(const QuadForm<T>& q, std::shared_ptr<F> GF)
     {
         this->q = q;
         this->disc = q.discriminant();
 
-        QuadFormFp<R,S> qp = q.mod(GF);
+        QuadFormFp<R,S,F> qp = q.mod(GF);
 
         this->a = qp.a();
         this->b = qp.b();
@@ -84,73 +84,117 @@ public:
         }
         else
         {
-            R at = a0;
-            if (t == 1) at = GF->add(at, delta);
-            else if (t >= 2)
-            {
-                R temp = GF->mul(t-1, b);
-                temp = GF->add(temp, delta);
-                temp = GF->mul(temp, t);
-                at = GF->add(temp, at);
-            }
-            if (at >= p) at = GF->mod(at);
-
-            if (at == 0)
-            {
-                res.x = vec.x ? vec.x-1 : p-1;
-                res.y = GF->sub(vec.y, t);
-                res.z = 1;
-            }
-            else
-            {
-                R ct = GF->mul(b, t);
-                ct = GF->add(ct, h);
-                ct = GF->mul(ct, t);
-                ct = GF->add(ct, a);
-                if (ct >= p) ct = GF->mod(ct);
-
-                if (ct == 0)
-                {
-                    if (t == 0)
-                    {
-                        res.x = 1;
-                        res.y = 0;
-                        res.z = 0;
-                    }
-                    else
-                    {
-                        res.x = GF->inverse(t);
-                        res.y = 1;
-                        res.z = 0;
-                    }
-                }
-                else
-                {
-                    R inv = GF->mul(at, GF->inverse(ct));
-                    res.x = GF->add(vec.x, inv-1);
-                    res.y = GF->sub(vec.y, t);
-                    res.y = GF->add(res.y, GF->mul(t, inv));
-                    res.z = 1;
-                }
-            }
+            R at = this->isotropic_numerator(t);
+            R ct = (at == 0) ? 0 : this->isotropic_denominator(t);
+            R ct_inv = (ct == 0) ? 0 : GF->inverse(ct);
+            res = this->isotropic_vector(t, at, ct, ct_inv);
         }
 
         #ifdef DEBUG
-        QuadFormFp<R,S> qp = this->q.mod(GF);
+        QuadFormFp<R,S,F> qp = this->q.mod(GF);
         assert( qp.evaluate(res) % this->GF->prime() == 0 );
         #endif
 
         return res;
     }
 
-    inline GenusRep<T> get_reduced_neighbor_rep(R t) const
+    // Computes the isotropic vectors associated to t0, ..., t0+n-1, with n at
+    // most block_size. The inverses these require are computed together.
+    void isotropic_vectors(R t0, size_t n, Vector3<R> *vecs) const
+    {
+        R p = GF->prime();
+
+        // The number of values of t which are less than p.
+        size_t m = (t0 + n > p) ? p - t0 : n;
+        if (p == 2) m = 0;
+
+        std::array<R, block_size> at;
+        std::array<R, block_size> ct;
+        std::array<R, block_size> ct_inv;
+
+        if (m > 0)
+        {
+            // Both at and ct are quadratic in t, so we step through them
+            // with their first and second differences, which are
+            //   at(t+1) - at(t) = 2bt + delta,
+            //   ct(t+1) - ct(t) = 2bt + b + h,
+            // and 2b in both cases.
+            R b2 = GF->add(b, b);
+            R at_t = this->isotropic_numerator(t0);
+            R ct_t = this->isotropic_denominator(t0);
+            R at_diff = GF->add(GF->mul(b2, t0), delta);
+            R ct_diff = GF->add(GF->mul(b2, t0), GF->add(b, h));
+
+            for (size_t k=0; k<m; k++)
+            {
+                at[k] = (at_t >= p) ? GF->mod(at_t) : at_t;
+                ct[k] = (ct_t >= p) ? GF->mod(ct_t) : ct_t;
+
+                at_t = GF->add(at_t, at_diff);
+                ct_t = GF->add(ct_t, ct_diff);
+                at_diff = GF->add(at_diff, b2);
+                ct_diff = GF->add(ct_diff, b2);
+            }
+        }
+
+        GF->inverse(ct.data(), ct_inv.data(), m);
+
+        for (size_t k=0; k<m; k++)
+        {
+            vecs[k] = this->isotropic_vector(t0+k, at[k], ct[k], ct_inv[k]);
+
+            #ifdef DEBUG
+            QuadFormFp<R,S,F> qp = this->q.mod(GF);
+            assert( qp.evaluate(vecs[k]) % p == 0 );
+            #endif
+        }
+
+        for (size_t k=m; k<n; k++)
+        {
+            vecs[k] = this->isotropic_vector(t0+k);
+        }
+    }
+
+    // Computes the reduced neighbor associated to t and stores it in rep, so
+    // that callers may reuse the same representative for many neighbors.
+    inline void get_reduced_neighbor_rep(R t, GenusRep<T>& rep) const
     {
-        GenusRep<T> rep;
         rep.q = this->get_neighbor(t, rep.s);
         rep.q = QuadForm<T>::reduce(rep.q, rep.s);
-        return rep;
     }
 
+    // Computes the reduced neighbors associated to t0, ..., t0+n-1 and stores
+    // them in reps. The neighbors are reduced together as a block, with n at
+    // most block_size. If track is not set, the isometries of reps are left
+    // unspecified, which saves their bookkeeping during reduction.
+    void get_reduced_neighbor_reps(R t0, size_t n, GenusRep<T> *reps, bool track=true)
+    {
+        #ifdef DEBUG
+        assert( n <= block_size );
+        #endif
+
+        this->isotropic_vectors(t0, n, this->block_vec.data());
+
+        for (size_t k=0; k<n; k++)
+        {
+            this->block_q[k] = this->build_neighbor(this->block_vec[k], this->block_s[k]);
+        }
+
+        if (track)
+            QuadForm<T>::reduce(this->block_q.data(), this->block_s.data(), n);
+        else
+            QuadForm<T>::reduce(this->block_q.data(), n);
+
+        for (size_t k=0; k<n; k++)
+        {
+            std::swap(reps[k].q, this->block_q[k]);
+            std::swap(reps[k].s, this->block_s[k]);
+        }
+    }
+
+    // The number of neighbors which are reduced together.
+    static constexpr size_t block_size = 64;
+
     Vector3<R> transform_vector(const GenusRep<T>& dst, Vector3<R> src)
     {
         Vector3<T> temp;
@@ -160,8 +204,8 @@ public:
 
         R p = GF->prime();
 
-        Isometry<T> sinv = dst.s.inverse(p);
-        temp = sinv * temp;
+        this->sinv.set_inverse(dst.s, p);
+        temp = this->sinv * temp;
 
         #ifdef DEBUG
         assert( temp.x % p == 0 );
@@ -177,25 +221,8 @@ public:
         vec.x = GF->mod(temp.x);
         vec.y = GF->mod(temp.y);
         vec.z = GF->mod(temp.z);
-        if (vec.z != 0)
-        {
-            R inv = GF->inverse(vec.z);
-            vec.x = GF->mod(GF->mul(vec.x, inv));
-            vec.y = GF->mod(GF->mul(vec.y, inv));
-            vec.z = 1;
-        }
-        else if (vec.y != 0)
-        {
-            R inv = GF->inverse(vec.y);
-            vec.x = GF->mod(GF->mul(vec.x, inv));
-            vec.y = 1;
-        }
-        else if (vec.z != 0)
-        {
-            vec.x = 1;
-        }
 
-        return vec;
+        return this->normalize_vector(vec);
     }
 
     QuadForm<T> get_neighbor(R t, Isometry<T>& s) const
@@ -223,12 +250,15 @@ public:
         if (vec.x > (p>>1)) vec.x -= p;
         if (vec.y > (p>>1)) vec.y -= p;
 
+        // The coordinate chart in which the isotropic vector lies, which
+        // determines the initial change of basis.
+        int chart;
+        T u = vec.x;
+        T v = vec.y;
+
         if (vec.z == 1)
         {
-            T u = vec.x;
-            T v = vec.y;
-
-            s.set_values(u, 0, -1, v, 1, 0, 1, 0, 0);
+            chart = 0;
 
             T au = q.a() * u;
             T hu = q.h() * u;
@@ -245,9 +275,8 @@ public:
         }
         else if (vec.y == 1)
         {
-            T u = vec.x;
+            chart = 1;
 
-            s.set_values(u, 0, 1, 1, 0, 0, 0, 1, 0);
             T au = q.a()*u;
             T gu = q.g()*u;
             T temp = au + q.h();
@@ -261,7 +290,7 @@ public:
         }
         else
         {
-            s.set_values(1, 0, 0, 0, 0, -1, 0, 1, 0);
+            chart = 2;
 
             aa = q.a();
             bb = q.c();
@@ -278,9 +307,9 @@ public:
         #endif
 
         T gmodp = gg % p;
-        if (gmodp == 0)
+        bool swap = (gmodp == 0);
+        if (swap)
         {
-            s.A1000010n0();
 
             T temp = bb;
             bb = cc;
@@ -311,8 +340,6 @@ public:
         if (s1 < -(p>>1)) s1 += p;
         if (s2 < -(pp>>1)) s2 += pp;
 
-        s.A1000100t1(s1);
-
         T temp1 = cc * s1;
         bb += s1 * (ff + temp1);
         ff += 2*temp1;
@@ -322,7 +349,6 @@ public:
         assert( hh % p == 0 );
         #endif
 
-        s.A100010t01(s2);
         T temp2 = cc * s2;
         aa += s2 * (gg + temp2);
         gg += 2 * temp2;
@@ -334,7 +360,7 @@ public:
         assert( hh % p == 0 );
         #endif
 
-        s.A1000p000p2(p, pp);
+        this->set_isometry(s, chart, swap, u, v, s1, s2, p, pp);
         aa /= pp;
         cc *= pp;
         ff *= p;
@@ -356,7 +382,7 @@ public:
     }
 
 private:
-    std::shared_ptr<Fp<R,S>> GF;
+    std::shared_ptr<F> GF;
     QuadForm<T> q;
     T disc;
     R a, b, c, f, g, h;
@@ -364,6 +390,138 @@ private:
     R a0;
     R delta;
 
+    // Storage for the inverse isometry used by transform_vector.
+    Isometry<T> sinv;
+
+    // Storage for the blocks of neighbors built by get_reduced_neighbor_reps.
+    std::array<Vector3<R>, block_size> block_vec;
+    std::array<QuadForm<T>, block_size> block_q;
+    std::array<Isometry<T>, block_size> block_s;
+
+    // The value of the quadratic form at the affine isotropic line through
+    // vec associated to t < p, up to a common factor.
+    R isotropic_numerator(R t) const
+    {
+        R p = GF->prime();
+        R at = a0;
+        if (t == 1) at = GF->add(at, delta);
+        else if (t >= 2)
+        {
+            R temp = GF->mul(t-1, b);
+            temp = GF->add(temp, delta);
+            temp = GF->mul(temp, t);
+            at = GF->add(temp, at);
+        }
+        if (at >= p) at = GF->mod(at);
+        return at;
+    }
+
+    // The quantity bt^2 + ht + a, which must be inverted to find the second
+    // intersection of the line associated to t < p with the conic.
+    R isotropic_denominator(R t) const
+    {
+        R p = GF->prime();
+        R ct = GF->mul(b, t);
+        ct = GF->add(ct, h);
+        ct = GF->mul(ct, t);
+        ct = GF->add(ct, a);
+        if (ct >= p) ct = GF->mod(ct);
+        return ct;
+    }
+
+    // Finishes the computation of the isotropic vector associated to t < p,
+    // given its numerator, denominator and the inverse of the denominator.
+    Vector3<R> isotropic_vector(R t, R at, R ct, R ct_inv) const
+    {
+        Vector3<R> res;
+        R p = GF->prime();
+
+        if (at == 0)
+        {
+            res.x = vec.x ? vec.x-1 : p-1;
+            res.y = GF->sub(vec.y, t);
+            res.z = 1;
+        }
+        else if (ct == 0)
+        {
+            if (t == 0)
+            {
+                res.x = 1;
+                res.y = 0;
+                res.z = 0;
+            }
+            else
+            {
+                res.x = GF->inverse(t);
+                res.y = 1;
+                res.z = 0;
+            }
+        }
+        else
+        {
+            R inv = GF->mul(at, ct_inv);
+            res.x = GF->add(vec.x, inv-1);
+            res.y = GF->sub(vec.y, t);
+            res.y = GF->add(res.y, GF->mul(t, inv));
+            res.z = 1;
+        }
+
+        return res;
+    }
+
+    // Sets s to the change of basis computed by build_neighbor. This is the
+    // initial basis of the chart, with its last two columns exchanged if
+    // swap is set, followed by the column operations A1000100t1(s1),
+    // A100010t01(s2) and A1000p000p2(p, pp). The third column of the basis
+    // is always a signed unit vector, so the product has a closed form.
+    static void set_isometry(Isometry<T>& s, int chart, bool swap,
+                             const T& u, const T& v, const T& s1, const T& s2,
+                             const T& p, const T& pp)
+    {
+        T s1p = s1 * p;
+
+        if (chart == 0)
+        {
+            if (swap) s.set_values(u, p, 0, v+s2, s1p, pp, 1, 0, 0);
+            else      s.set_values(u-s2, -s1p, -pp, v, p, 0, 1, 0, 0);
+        }
+        else if (chart == 1)
+        {
+            if (swap) s.set_values(u, -p, 0, 1, 0, 0, s2, s1p, pp);
+            else      s.set_values(u+s2, s1p, pp, 1, 0, 0, 0, p, 0);
+        }
+        else
+        {
+            if (swap) s.set_values(1, 0, 0, 0, p, 0, s2, s1p, pp);
+            else      s.set_values(1, 0, 0, -s2, -s1p, -pp, 0, p, 0);
+        }
+    }
+
+    // Scales a nonzero vector over F_p so that its last nonzero coordinate
+    // is one.
+    Vector3<R> normalize_vector(Vector3<R> vec) const
+    {
+        if (vec.z != 0)
+        {
+            R inv = GF->inverse(vec.z);
+            vec.x = GF->mod(GF->mul(vec.x, inv));
+            vec.y = GF->mod(GF->mul(vec.y, inv));
+            vec.z = 1;
+        }
+        else if (vec.y != 0)
+        {
+            R inv = GF->inverse(vec.y);
+            vec.x = GF->mod(GF->mul(vec.x, inv));
+            vec.y = 1;
+        }
+        else if (vec.z != 0)
+        {
+            vec.x = 1;
+        }
+
+        return vec;
+    }
+
     // The 2-isotropic vectors were stored in binary within each of the
     // coordinates of `vec` and so we use this function to unpack them into
     // actual 2-isotropic vectors.
@@ -394,4 +552,28 @@ private:
     }
 };
 
+template<>
+Z_QuadForm Z_W16_NeighborManager::build_neighbor(W16_Vector3& vec2, Z_Isometry& s) const;
+
+template<>
+Z_QuadForm Z_W32_NeighborManager::build_neighbor(W32_Vector3& vec2, Z_Isometry& s) const;
+
+template<>
+Z_QuadForm Z_W64_NeighborManager::build_neighbor(W64_Vector3& vec2, Z_Isometry& s) const;
+
+template<>
+Z_QuadForm Z_W16_F2_NeighborManager::build_neighbor(W16_Vector3& vec2, Z_Isometry& s) const;
+
+template<>
+W16_Vector3 Z_W16_NeighborManager::transform_vector(const Z_GenusRep& dst, W16_Vector3 src);
+
+template<>
+W32_Vector3 Z_W32_NeighborManager::transform_vector(const Z_GenusRep& dst, W32_Vector3 src);
+
+template<>
+W64_Vector3 Z_W64_NeighborManager::transform_vector(const Z_GenusRep& dst, W64_Vector3 src);
+
+template<>
+W16_Vector3 Z_W16_F2_NeighborManager::transform_vector(const Z_GenusRep& dst, W16_Vector3 src);
+
 #endif // __NEIGHBOR_MANAGER_H
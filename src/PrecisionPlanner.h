@@ -0,0 +1,200 @@
+#ifndef __PRECISION_PLANNER_H_
+#define __PRECISION_PLANNER_H_
+
+#include "birch.h"
+#include "Genus.h"
+
+// Determines a priori which integer type is wide enough to carry out the
+// neighbor computations for a genus without overflowing. Every bound below is
+// an upper bound on the absolute value of an intermediate quantity, expressed
+// in terms of the discriminant D, the largest coefficients of the (reduced)
+// genus representatives, the largest scalar N (the product of the primes) along the parent
+// chains, and the prime p.
+//
+// All reduced representatives satisfy 0 < a <= b <= c, |g|,|h| <= a, and
+// |f| <= b. Entries of a scaled isometry s with s^t Q s = lambda^2 Q' are
+// bounded using v_j^2 <= Q(v) * cof_jj / D, where cof_jj <= 4bc is a cofactor
+// of the Gram matrix of Q.
+template<typename R>
+class PrecisionPlanner
+{
+public:
+    PrecisionPlanner(const Genus<R>& genus)
+    {
+        this->D = abs(birch_util::convert_Integer<R,Z>(genus.disc));
+        this->A = 0;
+        this->B = 0;
+        this->C = 0;
+        this->N = 1;
+        this->S = 1;
+
+        for (size_t n=0; n<genus.size(); n++)
+        {
+            const QuadForm<R>& q = genus.form(n);
+            this->update_max(this->A, q.a());
+            this->update_max(this->A, q.g());
+            this->update_max(this->A, q.h());
+            this->update_max(this->B, q.b());
+            this->update_max(this->B, q.f());
+            this->update_max(this->C, q.c());
+
+            this->update_max(this->N, genus.scalar(n));
+
+            this->update_max(this->S, genus.isometry(n));
+            this->update_max(this->S, genus.inverse_isometry(n));
+        }
+
+        // Any representative may be the mother form of a neighbor, so the
+        // diagonal bounds must also be monotone.
+        update_bound(this->B, this->A);
+        update_bound(this->C, this->B);
+
+        // The representatives themselves, along with their scalars and the
+        // conductors (which divide the discriminant).
+        this->genus_bound = this->C;
+        update_bound(this->genus_bound, this->S);
+        update_bound(this->genus_bound, this->N);
+        update_bound(this->genus_bound, this->D);
+    }
+
+    // The number of bits (including sign) needed to store the genus.
+    size_t genus_bits(void) const
+    {
+        return PrecisionPlanner<R>::bits(this->genus_bound);
+    }
+
+    // The number of bits (including sign) needed to compute Hecke matrices,
+    // eigenvalues, and isometry sequences at the prime p.
+    size_t hecke_bits(const R& p) const
+    {
+        return PrecisionPlanner<R>::bits(this->hecke_bound(birch_util::convert_Integer<R,Z>(p)));
+    }
+
+    int genus_type(void) const
+    {
+        return PrecisionPlanner<R>::narrowest(this->genus_bits());
+    }
+
+    int hecke_type(const R& p) const
+    {
+        int type = PrecisionPlanner<R>::narrowest(this->hecke_bits(p));
+        int gtype = this->genus_type();
+        return PrecisionPlanner<R>::wider(type, gtype);
+    }
+
+    // Returns the narrowest integer type whose magnitude can hold the
+    // specified number of bits. We leave one guard bit in addition to the
+    // sign bit.
+    static int narrowest(size_t bits)
+    {
+        if (bits < 64) return PrecisionPlanner<R>::TYPE_Z64;
+        if (bits < 128) return PrecisionPlanner<R>::TYPE_Z128;
+        return PrecisionPlanner<R>::TYPE_Z;
+    }
+
+    static constexpr int TYPE_Z64 = 0;
+    static constexpr int TYPE_Z128 = 1;
+    static constexpr int TYPE_Z = 2;
+
+private:
+    Z D;
+    Z A, B, C;
+    Z N;
+    Z S;
+    Z genus_bound;
+
+    static int wider(int type1, int type2)
+    {
+        return type1 > type2 ? type1 : type2;
+    }
+
+    static size_t bits(const Z& x)
+    {
+        return mpz_sizeinbase(x.get_mpz_t(), 2) + 2;
+    }
+
+    static void update_max(Z& x, const R& value)
+    {
+        Z y = abs(birch_util::convert_Integer<R,Z>(value));
+        if (x < y) x = y;
+    }
+
+    static void update_bound(Z& x, const Z& y)
+    {
+        if (x < y) x = y;
+    }
+
+    static void update_max(Z& x, const Isometry<R>& s)
+    {
+        update_max(x, s.a11); update_max(x, s.a12); update_max(x, s.a13);
+        update_max(x, s.a21); update_max(x, s.a22); update_max(x, s.a23);
+        update_max(x, s.a31); update_max(x, s.a32); update_max(x, s.a33);
+    }
+
+    static Z ceil_sqrt(const Z& x)
+    {
+        Z root;
+        mpz_sqrt(root.get_mpz_t(), x.get_mpz_t());
+        return root + 1;
+    }
+
+    static Z ceil_div(const Z& x, const Z& y)
+    {
+        Z q;
+        mpz_cdiv_q(q.get_mpz_t(), x.get_mpz_t(), y.get_mpz_t());
+        return q;
+    }
+
+    // Bounds the entries of an isometry s with s^t Q s = lambda^2 Q', where Q
+    // is a representative and the diagonal of Q' is bounded by X.
+    Z isometry_bound(const Z& lambda, const Z& X) const
+    {
+        return ceil_sqrt(ceil_div(4 * lambda * lambda * X * this->B * this->C, this->D));
+    }
+
+    Z hecke_bound(const Z& p) const
+    {
+        Z P = p + 1;
+        Z P2 = P * P;
+        Z bound = this->genus_bound;
+
+        // NeighborManager::build_neighbor: the lifts s1 and s2 are at most p/2
+        // and p^2/2, respectively, and the isotropic vector is centered.
+        Z neighbor = this->C + 2 * this->B * P2 + this->B * P2 * P2;
+        update_bound(bound, neighbor);
+
+        // The neighbor's isometry prior to reduction.
+        update_bound(bound, P2 * P);
+
+        // QuadForm::reduce: the diagonal entries of the neighbor bound all
+        // coefficients encountered during reduction, up to a small multiple.
+        Z K = 2 * this->C + 8 * this->B * P2;
+        update_bound(bound, 4 * K);
+
+        // The isometry during reduction, including the products t*s.
+        update_bound(bound, 2 * this->isometry_bound(p, 4 * K));
+
+        // The composite isometries cur.s * foo.s * rep.sinv from the mother
+        // form to itself. Each matrix product sums three terms.
+        Z foo = this->isometry_bound(p, this->C);
+        Z half = this->isometry_bound(p * this->N, this->C);
+        Z full = this->isometry_bound(p * this->N * this->N, this->C);
+        update_bound(bound, 3 * this->S * foo);
+        update_bound(bound, 3 * this->S * half);
+        update_bound(bound, full);
+
+        // Spinor::norm, evaluated with the composite isometry and the scalar
+        // p * N^2.
+        Z scalar = p * this->N * this->N;
+        Z spin = (full > scalar) ? full : scalar;
+        update_bound(bound, 16 * this->A * this->B * spin);
+
+        // NeighborManager::transform_vector inverts the neighbor isometry and
+        // applies it to a vector whose coordinates are less than p.
+        update_bound(bound, 6 * foo * foo);
+
+        return bound;
+    }
+};
+
+#endif // __PRECISION_PLANNER_H_
@@ -2,14 +2,16 @@
 #include "Isometry.h"
 #include "QuadForm.h"
 #include "Math.h"
+#include "Scratch.h"
 
 template<>
 Z Z_QuadForm::discriminant(void) const
 {
-    mpz_t disc;
-    mpz_t temp;
-    mpz_init(disc);
-    mpz_init(temp);
+    static thread_local Scratch<1> scratch;
+    mpz_ptr temp = scratch.ptr(0);
+
+    Z ret;
+    mpz_ptr disc = ret.get_mpz_t();
 
     mpz_mul(disc, this->b_.get_mpz_t(), this->c_.get_mpz_t());      // bc
     mpz_mul_2exp(disc, disc, 2);                                    // 4bc
@@ -21,11 +23,6 @@ Z Z_QuadForm::discriminant(void) const
     mpz_submul(temp, this->c_.get_mpz_t(), this->h_.get_mpz_t());   // fg-ch
     mpz_addmul(disc, temp, this->h_.get_mpz_t());                   // discriminant
 
-    Z ret(disc);
-
-    mpz_clear(temp);
-    mpz_clear(disc);
-
     return ret;
 }
 
@@ -43,10 +40,11 @@ bool Z_QuadForm::operator==(const Z_QuadForm& q) const
 template<>
 Z Z_QuadForm::evaluate(const Z& x, const Z& y, const Z& z) const
 {
-    mpz_t value;
-    mpz_t temp;
-    mpz_init(value);
-    mpz_init(temp);
+    static thread_local Scratch<1> scratch;
+    mpz_ptr temp = scratch.ptr(0);
+
+    Z ret;
+    mpz_ptr value = ret.get_mpz_t();
 
     mpz_mul(value, this->a_.get_mpz_t(), x.get_mpz_t());    // ax
     mpz_addmul(value, this->g_.get_mpz_t(), z.get_mpz_t()); // ax+gz
@@ -58,29 +56,38 @@ Z Z_QuadForm::evaluate(const Z& x, const Z& y, const Z& z) const
     mpz_mul(temp, this->c_.get_mpz_t(), z.get_mpz_t());     // cz
     mpz_addmul(value, temp, z.get_mpz_t());                 // evaluate
 
-    Z ret(value);
-
-    mpz_clear(temp);
-    mpz_clear(value);
-
     return ret;
 }
 
-template<>
-Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
+// Reduces q with arbitrary precision arithmetic, applying the same change of
+// basis to s if track is set.
+template<bool track>
+static Z_QuadForm reduce_Z(const Z_QuadForm& q, Z_Isometry& s)
 {
-    mpz_t a, b, c, f, g, h;
-    mpz_init_set(a, q.a_.get_mpz_t());
-    mpz_init_set(b, q.b_.get_mpz_t());
-    mpz_init_set(c, q.c_.get_mpz_t());
-    mpz_init_set(f, q.f_.get_mpz_t());
-    mpz_init_set(g, q.g_.get_mpz_t());
-    mpz_init_set(h, q.h_.get_mpz_t());
-
-    // TODO: Move these into some kind of "scratch" space so that we can
-    // avoid reallocating these every time we call this function.
-    mpz_t t, num, den, temp, temp2, temp3;
-    mpz_inits(t, num, den, temp, temp2, temp3, NULL);
+    // The temporaries persist across calls, so that reducing a form does not
+    // allocate once they have grown large enough.
+    static thread_local Scratch<12> scratch;
+
+    mpz_ptr a = scratch.ptr(0);
+    mpz_ptr b = scratch.ptr(1);
+    mpz_ptr c = scratch.ptr(2);
+    mpz_ptr f = scratch.ptr(3);
+    mpz_ptr g = scratch.ptr(4);
+    mpz_ptr h = scratch.ptr(5);
+    mpz_set(a, q.a().get_mpz_t());
+    mpz_set(b, q.b().get_mpz_t());
+    mpz_set(c, q.c().get_mpz_t());
+    mpz_set(f, q.f().get_mpz_t());
+    mpz_set(g, q.g().get_mpz_t());
+    mpz_set(h, q.h().get_mpz_t());
+
+    const Z& tt = scratch[6];
+    mpz_ptr t = scratch.ptr(6);
+    mpz_ptr num = scratch.ptr(7);
+    mpz_ptr den = scratch.ptr(8);
+    mpz_ptr temp = scratch.ptr(9);
+    mpz_ptr temp2 = scratch.ptr(10);
+    mpz_ptr temp3 = scratch.ptr(11);
 
     int flag = 1;
     while (flag)
@@ -91,7 +98,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_add(t, t, h);
         if (mpz_cmp_ui(t, 0) < 0)
         {
-            s.A101011001();
+            if (track) s.A101011001();
             mpz_add(c, c, t);
             mpz_add(f, f, h);
             mpz_add(f, f, b);
@@ -116,7 +123,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         }
         if (mpz_cmp_ui(t, 0) != 0)
         {
-            s.A1t0010001(Z(t));
+            if (track) s.A1t0010001(tt);
             mpz_mul(temp, a, t);
             mpz_add(h, h, temp);
             mpz_addmul(b, h, t);
@@ -139,7 +146,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         }
         if (mpz_cmp_ui(t, 0) != 0)
         {
-            s.A10001t001(Z(t));
+            if (track) s.A10001t001(tt);
             mpz_mul(temp, b, t);
             mpz_add(f, f, temp);
             mpz_addmul(c, f, t);
@@ -162,7 +169,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         }
         if (mpz_cmp_ui(t, 0) != 0)
         {
-            s.A10t010001(Z(t));
+            if (track) s.A10t010001(tt);
             mpz_mul(temp, a, t);
             mpz_add(g, g, temp);
             mpz_addmul(c, g, t);
@@ -172,21 +179,21 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
 
         if (mpz_cmp(a, b) > 0 || (mpz_cmp(a, b) == 0 && mpz_cmpabs(f, g) > 0))
         {
-            s.A0n0n0000n();
+            if (track) s.A0n0n0000n();
             mpz_swap(a, b);
             mpz_swap(f, g);
         }
 
         if (mpz_cmp(b, c) > 0 || (mpz_cmp(b, c) == 0 && mpz_cmpabs(g, h) > 0))
         {
-            s.An0000n0n0();
+            if (track) s.An0000n0n0();
             mpz_swap(b, c);
             mpz_swap(g, h);
         }
 
         if (mpz_cmp(a, b) > 0 || (mpz_cmp(a, b) == 0 && mpz_cmpabs(f, g) > 0))
         {
-            s.A0n0n0000n();
+            if (track) s.A0n0n0000n();
             mpz_swap(a, b);
             mpz_swap(f, g);
         }
@@ -205,19 +212,19 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         {
             if (mpz_cmp_ui(f, 0) < 0)
             {
-                s.An00010001();
+                if (track) s.An00010001();
                 mpz_neg(f, f);
             }
 
             if (mpz_cmp_ui(g, 0) < 0)
             {
-                s.A1000n0001();
+                if (track) s.A1000n0001();
                 mpz_neg(g, g);
             }
 
             if (mpz_cmp_ui(h, 0) < 0)
             {
-                s.A10001000n();
+                if (track) s.A10001000n();
                 mpz_neg(h, h);
             }
         }
@@ -239,19 +246,19 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
 
             if (s1 == 1)
             {
-                s.An00010001();
+                if (track) s.An00010001();
                 mpz_neg(f, f);
             }
 
             if (s2 == 1)
             {
-                s.A1000n0001();
+                if (track) s.A1000n0001();
                 mpz_neg(g, g);
             }
 
             if (s3 == 1)
             {
-                s.A10001000n();
+                if (track) s.A10001000n();
                 mpz_neg(h, h);
             }
         }
@@ -272,7 +279,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
 
     if (mpz_cmp_ui(temp, 0) == 0 && mpz_cmp_ui(temp2, 0) > 0)
     {
-        s.An010n1001();
+        if (track) s.An010n1001();
         mpz_add(f, f, h);
         mpz_add(f, f, b);
         mpz_add(f, f, b);
@@ -286,7 +293,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_neg(temp, h);
         if (mpz_cmp(a, temp) == 0)
         {
-            s.Ann00n0001();
+            if (track) s.Ann00n0001();
             mpz_add(f, f, g);
             mpz_neg(f, f);
             mpz_neg(g, g);
@@ -299,7 +306,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_neg(temp, g);
         if (mpz_cmp(a, temp) == 0)
         {
-            s.An0n01000n();
+            if (track) s.An0n01000n();
             mpz_add(f, f, h);
             mpz_neg(f, f);
             mpz_neg(h, h);
@@ -313,7 +320,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_neg(temp, f);
         if (mpz_cmp(b, temp) == 0)
         {
-            s.A1000nn00n();
+            if (track) s.A1000nn00n();
             mpz_add(g, g, h);
             mpz_neg(g, g);
             mpz_neg(h, h);
@@ -327,7 +334,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_add(temp, f, f);
         if (mpz_cmp(g, temp) > 0)
         {
-            s.Ann001000n();
+            if (track) s.Ann001000n();
             mpz_sub(f, g, f);
         }
     }
@@ -337,7 +344,7 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_add(temp, f, f);
         if (mpz_cmp(h, temp) > 0)
         {
-            s.An0n0n0001();
+            if (track) s.An0n0n0001();
             mpz_sub(f, h, f);
         }
     }
@@ -347,35 +354,45 @@ Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
         mpz_add(temp, g, g);
         if (mpz_cmp(h, temp) > 0)
         {
-            s.An000nn001();
+            if (track) s.An000nn001();
             mpz_sub(g, h, g);
         }
     }
 
     if (mpz_cmp(a, b) == 0 && mpz_cmpabs(f, g) > 0)
     {
-        s.A0n0n0000n();
+        if (track) s.A0n0n0000n();
         mpz_swap(a, b);
         mpz_swap(f, g);
     }
 
     if (mpz_cmp(b, c) == 0 && mpz_cmpabs(g, h) > 0)
     {
-        s.An0000n0n0();
+        if (track) s.An0000n0n0();
         mpz_swap(g, h);
     }
 
     if (mpz_cmp(a, b) == 0 && mpz_cmpabs(f, g) > 0)
     {
-        s.A0n0n0000n();
+        if (track) s.A0n0n0000n();
         mpz_swap(f, g);
     }
 
-    Z_QuadForm ret = Z_QuadForm(Z(a), Z(b), Z(c), Z(f), Z(g), Z(h));
+    return Z_QuadForm(scratch[0], scratch[1], scratch[2],
+                      scratch[3], scratch[4], scratch[5]);
+}
 
-    mpz_clears(a, b, c, f, g, h, t, num, den, temp, temp2, temp3, NULL);
+template<>
+Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s)
+{
+    return reduce_Z<true>(q, s);
+}
 
-    return ret;
+template<>
+Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q)
+{
+    static thread_local Z_Isometry s;
+    return reduce_Z<false>(q, s);
 }
 
 static W64 sign_vector(const Z& x, const Z& det, const std::vector<Z_PrimeSymbol>& primes)
@@ -776,28 +793,74 @@ Z_QuadForm Z_QuadForm::get_quad_form(const std::vector<Z_PrimeSymbol>& input)
     return q;
 }
 
+// Hashing of quadratic forms follows wyhash: every step multiplies two
+// 64-bit words into 128 bits and folds the halves together, so that every
+// bit of the coefficients affects every bit of the hash. Coefficients which
+// fit into a word hash to the same value for every integer type.
+static constexpr W64 WYHASH_P0 = 0xa0761d6478bd642fULL;
+static constexpr W64 WYHASH_P1 = 0xe7037ed1a0b428dbULL;
+static constexpr W64 WYHASH_P2 = 0x8ebc6af09c88c6e3ULL;
+static constexpr W64 WYHASH_P3 = 0x589965cc75374cc3ULL;
+
+static inline W64 wymix(W64 a, W64 b)
+{
+    W128 r = (W128)a * b;
+    return (W64)r ^ (W64)(r >> 64);
+}
+
+static inline W64 hash_words(const W64 *w)
+{
+    W64 h = WYHASH_P0;
+    h = wymix(w[0] ^ WYHASH_P1, w[1] ^ h);
+    h = wymix(w[2] ^ WYHASH_P2, w[3] ^ h);
+    h = wymix(w[4] ^ WYHASH_P3, w[5] ^ h);
+    return wymix(h ^ WYHASH_P0, 6 ^ WYHASH_P1);
+}
+
+// Reduces an arbitrary precision coefficient to a single word, mixing in
+// all of its limbs when it does not fit.
+static inline W64 hash_word(const Z& x)
+{
+    if (x.fits_slong_p())
+    {
+        return (W64)x.get_si();
+    }
+
+    mpz_srcptr z = x.get_mpz_t();
+    size_t size = mpz_size(z);
+    W64 h = wymix((W64)size ^ WYHASH_P2, (W64)mpz_sgn(z) ^ WYHASH_P3);
+    for (size_t k=0; k<size; k++)
+    {
+        h = wymix((W64)mpz_getlimbn(z, k) ^ WYHASH_P1, h ^ WYHASH_P0);
+    }
+    return h;
+}
+
+static inline W64 hash_word(const SmallZ& x)
+{
+    return x.is_small() ? (W64)x.get_si() : hash_word(x.get_z());
+}
+
 template<>
 W64 Z_QuadForm::hash_value(void) const
 {
-    W64 fnv = FNV_OFFSET;
-    fnv = (fnv ^ mpz_get_si(this->a_.get_mpz_t())) * FNV_PRIME;
-    fnv = (fnv ^ mpz_get_si(this->b_.get_mpz_t())) * FNV_PRIME;
-    fnv = (fnv ^ mpz_get_si(this->c_.get_mpz_t())) * FNV_PRIME;
-    fnv = (fnv ^ mpz_get_si(this->f_.get_mpz_t())) * FNV_PRIME;
-    fnv = (fnv ^ mpz_get_si(this->g_.get_mpz_t())) * FNV_PRIME;
-    fnv = (fnv ^ mpz_get_si(this->h_.get_mpz_t())) * FNV_PRIME;
-    return fnv;
+    W64 w[6] = { hash_word(this->a_), hash_word(this->b_), hash_word(this->c_),
+                 hash_word(this->f_), hash_word(this->g_), hash_word(this->h_) };
+    return hash_words(w);
 }
 
 template<>
 W64 Z64_QuadForm::hash_value(void) const
 {
-    W64 fnv = FNV_OFFSET;
-    fnv = (fnv ^ this->a_) * FNV_PRIME;
-    fnv = (fnv ^ this->b_) * FNV_PRIME;
-    fnv = (fnv ^ this->c_) * FNV_PRIME;
-    fnv = (fnv ^ this->f_) * FNV_PRIME;
-    fnv = (fnv ^ this->g_) * FNV_PRIME;
-    fnv = (fnv ^ this->h_) * FNV_PRIME;
-    return fnv;
+    W64 w[6] = { (W64)this->a_, (W64)this->b_, (W64)this->c_,
+                 (W64)this->f_, (W64)this->g_, (W64)this->h_ };
+    return hash_words(w);
+}
+
+template<>
+W64 SmallZ_QuadForm::hash_value(void) const
+{
+    W64 w[6] = { hash_word(this->a_), hash_word(this->b_), hash_word(this->c_),
+                 hash_word(this->f_), hash_word(this->g_), hash_word(this->h_) };
+    return hash_words(w);
 }
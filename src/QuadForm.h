@@ -3,6 +3,65 @@
 
 #include "birch.h"
 #include "birch_util.h"
+#include "Isometry.h"
+
+// A decision list over the border() predicates of a reduced form. The first
+// rule whose required predicates all hold, and whose forbidden predicates all
+// fail, selects the automorphism group of the form: the n-th rule selects the
+// n-th group of AUTOMORPHISM_ENTRIES. If no rule applies, the form only has
+// the trivial automorphisms, which make up the last group.
+struct BorderRule {
+    W32 required;
+    W32 forbidden;
+};
+
+#define BORDER(n) (1U << (n))
+
+constexpr BorderRule BORDER_RULES[AUTOMORPHISM_GROUPS-1] = {
+    { BORDER(1) | BORDER(2) | BORDER(9) | BORDER(14), 0 },
+    { BORDER(1) | BORDER(2) | BORDER(14), 0 },
+    { BORDER(1), BORDER(2) },
+    { BORDER(2), 0 },
+    { BORDER(3), 0 },
+    { BORDER(4) | BORDER(8) | BORDER(10), 0 },
+    { BORDER(4) | BORDER(10), 0 },
+    { BORDER(4), 0 },
+    { BORDER(5) | BORDER(6) | BORDER(7) | BORDER(8) | BORDER(15), 0 },
+    { BORDER(5) | BORDER(6) | BORDER(7), BORDER(8) },
+    { BORDER(5) | BORDER(11), BORDER(6) },
+    { BORDER(5), BORDER(6) },
+    { BORDER(6) | BORDER(9) | BORDER(12), 0 },
+    { BORDER(6) | BORDER(12), 0 },
+    { BORDER(6), 0 },
+    { BORDER(7) | BORDER(8) | BORDER(9) | BORDER(15) | BORDER(16), 0 },
+    { BORDER(7) | BORDER(8) | BORDER(15) | BORDER(16), 0 },
+    { BORDER(7) | BORDER(8) | BORDER(15), 0 },
+    { BORDER(7) | BORDER(9), 0 },
+    { BORDER(7), 0 },
+    { BORDER(8) | BORDER(9) | BORDER(10) | BORDER(11) | BORDER(12), 0 },
+    { BORDER(8) | BORDER(9) | BORDER(13) | BORDER(14), 0 },
+    { BORDER(8) | BORDER(9), 0 },
+    { BORDER(8) | BORDER(10) | BORDER(11) | BORDER(12), 0 },
+    { BORDER(8) | BORDER(10), 0 },
+    { BORDER(8) | BORDER(14), 0 },
+    { BORDER(8), 0 },
+    { BORDER(9) | BORDER(10) | BORDER(11) | BORDER(12), 0 },
+    { BORDER(9) | BORDER(12), 0 },
+    { BORDER(9) | BORDER(13) | BORDER(14), 0 },
+    { BORDER(9) | BORDER(14), 0 },
+    { BORDER(9) | BORDER(15), 0 },
+    { BORDER(9), 0 },
+    { BORDER(10) | BORDER(11) | BORDER(12), 0 },
+    { BORDER(10), 0 },
+    { BORDER(11), 0 },
+    { BORDER(12), 0 },
+    { BORDER(13) | BORDER(14), 0 },
+    { BORDER(14), 0 },
+    { BORDER(15) | BORDER(16), 0 },
+    { BORDER(15), 0 }
+};
+
+#undef BORDER
 
 template<typename R>
 class QuadForm
@@ -50,18 +109,37 @@ public:
         return this->evaluate(vec.x, vec.y, vec.z);
     }
 
-    template<typename S, typename T>
-    QuadFormFp<S,T> mod(std::shared_ptr<Fp<S,T>> GF) const
+    template<template<typename,typename> class F, typename S, typename T>
+    QuadFormFp<S,T,F<S,T>> mod(std::shared_ptr<F<S,T>> GF) const
     {
-        QuadFormFp<S,T> q(GF->mod(this->a_), GF->mod(this->b_), GF->mod(this->c_),
+        QuadFormFp<S,T,F<S,T>> q(GF->mod(this->a_), GF->mod(this->b_), GF->mod(this->c_),
                           GF->mod(this->f_), GF->mod(this->g_), GF->mod(this->h_), GF);
         return q;
     }
 
-    static Z_QuadForm get_quad_form(const std::vector<PrimeSymbol<R>>& primes)
+    // The form is found with arbitrary precision arithmetic and converted,
+    // so that a genus over a fixed precision type can be built from it
+    // directly.
+    static QuadForm<R> get_quad_form(const std::vector<PrimeSymbol<R>>& primes)
     {
-        static_assert( std::is_same<R,Z>::value, "Implemented only for arbitrary precision types." );
-        return Z_QuadForm(); // Make the compiler happy.
+        std::vector<Z_PrimeSymbol> symbols;
+        symbols.reserve(primes.size());
+        for (const PrimeSymbol<R>& symb : primes)
+        {
+            symbols.push_back(birch_util::convert_PrimeSymbol<R,Z>(symb));
+        }
+
+        Z_QuadForm q = Z_QuadForm::get_quad_form(symbols);
+        if (std::is_same<R,Z64>::value)
+        {
+            if (!q.a().fits_slong_p() || !q.b().fits_slong_p() || !q.c().fits_slong_p() ||
+                !q.f().fits_slong_p() || !q.g().fits_slong_p() || !q.h().fits_slong_p())
+            {
+                throw std::overflow_error(
+                    "The quadratic form does not fit into 64-bit integers.");
+            }
+        }
+        return birch_util::convert_QuadForm<Z,R>(q);
     }
 
     static int border(const QuadForm<R>& q, int n)
@@ -109,425 +187,62 @@ public:
         }
     }
 
-    static int num_automorphisms(const QuadForm<R>& q)
+    // The predicates border(q, n) which hold, as a bitmask.
+    static W32 border_mask(const QuadForm<R>& q)
     {
-        if (border(q, 1))
-        {
-            if (border(q, 2))
-            {
-                if (border(q, 14))
-                {
-                    if (border(q, 9))
-                        return 16;
-                    else
-                        return 8;
-                }
-            }
-            else
-                return 4;
-        }
-
-        if (border(q, 2))
-            return 4;
-
-        if (border(q, 3))
-            return 4;
-
-        if (border(q, 4))
-        {
-            if (border(q, 10))
-            {
-                if (border(q, 8))
-                    return 24;
-                else
-                    return 8;
-            }
-            else
-                return 4;
-        }
-
-        if (border(q, 5))
-        {
-            if (border(q, 6))
-            {
-                if (border(q, 7))
-                {
-                    if (border(q, 8))
-                    {
-                        if (border(q, 15))
-                            return 16;
-                    }
-                    else
-                        return 8;
-                }
-            }
-            else if (border(q, 11))
-                return 8;
-            else
-                return 4;
-        }
-
-        if (border(q, 6))
+        W32 mask = 0;
+        for (int n=1; n<=16; n++)
         {
-            if (border(q, 12))
-            {
-                if (border(q, 9))
-                    return 24;
-                else
-                    return 8;
-            }
-            else
-                return 4;
-        }
-
-        if (border(q, 7))
-        {
-            if (border(q, 8) && border(q, 15))
-            {
-                if (border(q, 16))
-                {
-                    if (border(q, 9))
-                        return 48;
-                    else
-                        return 16;
-                }
-                else
-                    return 8;
-            }
-            else if (border(q, 9))
-                return 12;
-            else
-                return 4;
+            if (border(q, n)) mask |= 1U << n;
         }
+        return mask;
+    }
 
-        if (border(q, 8))
-        {
-            if (border(q, 9))
-            {
-                if (border(q, 10) && border(q, 11) && border(q, 12))
-                    return 48;
-                else if (border(q, 13) && border(q, 14))
-                    return 48;
-                else
-                    return 12;
-            }
-            else if (border(q, 10))
-            {
-                if (border(q, 11) && border(q, 12))
-                    return 16;
-                else
-                    return 8;
-            }
-            else if (border(q, 14))
-                return 12;
-            else
-                return 4;
-        }
+    static int automorphism_group(const QuadForm<R>& q)
+    {
+        W32 mask = border_mask(q);
+        if (mask == 0) return AUTOMORPHISM_GROUPS-1;
 
-        if (border(q, 9))
+        for (int n=0; n<AUTOMORPHISM_GROUPS-1; n++)
         {
-            if (border(q, 12))
-            {
-                if (border(q, 10) && border(q, 11))
-                    return 16;
-                else
-                    return 8;
-            }
-            else if (border(q, 14))
+            const BorderRule& rule = BORDER_RULES[n];
+            if ((mask & rule.required) == rule.required && !(mask & rule.forbidden))
             {
-                if (border(q, 13))
-                    return 8;
-                else
-                    return 8;
+                return n;
             }
-            else if (border(q, 15))
-                return 16;
-            else
-                return 4;
-        }
-
-        if (border(q, 10))
-        {
-            if (border(q, 11) && border(q, 12))
-                return 8;
-            else
-                return 4;
-        }
-
-        if (border(q, 11))
-            return 4;
-
-        if (border(q, 12))
-            return 4;
-
-        if (border(q, 13) && border(q, 14))
-            return 4;
-
-        if (border(q, 14))
-            return 4;
-
-        if (border(q, 15))
-        {
-            if (border(q, 16))
-                return 8;
-            else
-                return 4;
         }
+        return AUTOMORPHISM_GROUPS-1;
+    }
 
-        return 2;
+    // The automorphism group consists of the identity, the proper
+    // automorphisms of the form, and their negatives.
+    static int num_automorphisms(const QuadForm<R>& q)
+    {
+        int n = automorphism_group(q);
+        return 2 * (AUTOMORPHISM_OFFSETS[n+1] - AUTOMORPHISM_OFFSETS[n] + 1);
     }
 
     static const std::vector<Isometry<R>>& proper_automorphisms(const QuadForm<R>& q)
     {
-        if (border(q, 1))
-        {
-            if (border(q, 2))
-            {
-                if (border(q, 14))
-                {
-                    if (border(q, 9))
-                    {
-                        return Isometry<R>::automorphisms[0];
-                    }
-                    else
-                    {
-                        return Isometry<R>::automorphisms[1];
-                    }
-                }
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[2];
-            }
-        }
-
-        if (border(q, 2))
-        {
-            return Isometry<R>::automorphisms[3];
-        }
-
-        if (border(q, 3))
-        {
-            return Isometry<R>::automorphisms[4];
-        }
-
-        if (border(q, 4))
-        {
-            if (border(q, 10))
-            {
-                if (border(q, 8))
-                {
-                    return Isometry<R>::automorphisms[5];
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[6];
-                }
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[7];
-            }
-        }
-
-        if (border(q, 5))
-        {
-            if (border(q, 6))
-            {
-                if (border(q, 7))
-                {
-                    if (border(q, 8))
-                    {
-                        if (border(q, 15))
-                        {
-                            return Isometry<R>::automorphisms[8];
-                        }
-                    }
-                    else
-                    {
-                        return Isometry<R>::automorphisms[9];
-                    }
-                }
-            }
-            else if (border(q, 11))
-            {
-                return Isometry<R>::automorphisms[10];
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[11];
-            }
-        }
-
-        if (border(q, 6))
-        {
-            if (border(q, 12))
-            {
-                if (border(q, 9))
-                {
-                    return Isometry<R>::automorphisms[12];
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[13];
-                }
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[14];
-            }
-        }
-
-        if (border(q, 7))
-        {
-            if (border(q, 8) && border(q, 15))
-            {
-                if (border(q, 16))
-                {
-                    if (border(q, 9))
-                    {
-                        return Isometry<R>::automorphisms[15];
-                    }
-                    else
-                    {
-                        return Isometry<R>::automorphisms[16];
-                    }
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[17];
-                }
-            }
-            else if (border(q, 9))
-            {
-                return Isometry<R>::automorphisms[18];
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[19];
-            }
-        }
-
-        if (border(q, 8))
-        {
-            if (border(q, 9))
-            {
-                if (border(q, 10) && border(q, 11) && border(q, 12))
-                {
-                    return Isometry<R>::automorphisms[20];
-                }
-                else if (border(q, 13) && border(q, 14))
-                {
-                    return Isometry<R>::automorphisms[21];
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[22];
-                }
-            }
-            else if (border(q, 10))
-            {
-                if (border(q, 11) && border(q, 12))
-                {
-                    return Isometry<R>::automorphisms[23];
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[24];
-                }
-            }
-            else if (border(q, 14))
-            {
-                return Isometry<R>::automorphisms[25];
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[26];
-            }
-        }
-
-        if (border(q, 9))
-        {
-            if (border(q, 12))
-            {
-                if (border(q, 10) && border(q, 11))
-                {
-                    return Isometry<R>::automorphisms[27];
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[28];
-                }
-            }
-            else if (border(q, 14))
-            {
-                if (border(q, 13))
-                {
-                    return Isometry<R>::automorphisms[29];
-                }
-                else
-                {
-                    return Isometry<R>::automorphisms[30];
-                }
-            }
-            else if (border(q, 15))
-            {
-                return Isometry<R>::automorphisms[31];
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[32];
-            }
-        }
-
-        if (border(q, 10))
-        {
-            if (border(q, 11) && border(q, 12))
-            {
-                return Isometry<R>::automorphisms[33];
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[34];
-            }
-        }
-
-        if (border(q, 11))
-        {
-            return Isometry<R>::automorphisms[35];
-        }
-
-        if (border(q, 12))
-        {
-            return Isometry<R>::automorphisms[36];
-        }
-
-        if (border(q, 13) && border(q, 14))
-        {
-            return Isometry<R>::automorphisms[37];
-        }
-
-        if (border(q, 14))
-        {
-            return Isometry<R>::automorphisms[38];
-        }
+        return Isometry<R>::automorphisms(automorphism_group(q));
+    }
 
-        if (border(q, 15))
-        {
-            if (border(q, 16))
-            {
-                return Isometry<R>::automorphisms[39];
-            }
-            else
-            {
-                return Isometry<R>::automorphisms[40];
-            }
-        }
+    static QuadForm<R> reduce(const QuadForm<R>& q, Isometry<R>& s)
+    {
+        return QuadForm<R>::reduce_form<true>(q, s);
+    }
 
-        return Isometry<R>::automorphisms[41];
+    // Reduces q without keeping track of the change of basis, for when only
+    // the reduced form is needed.
+    static QuadForm<R> reduce(const QuadForm<R>& q)
+    {
+        Isometry<R> s;
+        return QuadForm<R>::reduce_form<false>(q, s);
     }
 
-    static QuadForm<R> reduce(const QuadForm<R>& q, Isometry<R>& s)
+    // Reduces q, applying the same change of basis to s if track is set.
+    template<bool track>
+    static QuadForm<R> reduce_form(const QuadForm<R>& q, Isometry<R>& s)
     {
         R a = q.a_;
         R b = q.b_;
@@ -542,7 +257,7 @@ public:
             R t = a + b + f + g + h;
             if (t < 0)
             {
-                s.A101011001();
+                if (track) s.A101011001();
                 c += t;
                 f += (h + b + b);
                 g += (h + a + a);
@@ -558,7 +273,7 @@ public:
             }
             if (t != 0)
             {
-                s.A1t0010001(t);
+                if (track) s.A1t0010001(t);
                 R temp = a * t;
                 h += temp;
                 b += h * t;
@@ -576,7 +291,7 @@ public:
             }
             if (t != 0)
             {
-                s.A10001t001(t);
+                if (track) s.A10001t001(t);
                 R temp = b * t;
                 f += temp;
                 c += f * t;
@@ -594,7 +309,7 @@ public:
             }
             if (t != 0)
             {
-                s.A10t010001(t);
+                if (track) s.A10t010001(t);
                 R temp = a * t;
                 g += temp;
                 c += g * t;
@@ -604,21 +319,21 @@ public:
 
             if (a > b || (a == b && abs(f) > abs(g)))
             {
-                s.A0n0n0000n();
+                if (track) s.A0n0n0000n();
                 t = a; a = b; b = t;
                 t = f; f = g; g = t;
             }
 
             if (b > c || (b == c && abs(g) > abs(h)))
             {
-                s.An0000n0n0();
+                if (track) s.An0000n0n0();
                 t = b; b = c; c = t;
                 t = g; g = h; h = t;
             }
 
             if (a > b || (a == b && abs(f) > abs(g)))
             {
-                s.A0n0n0000n();
+                if (track) s.A0n0n0000n();
                 t = a; a = b; b = t;
                 t = f; f = g; g = t;
             }
@@ -635,19 +350,19 @@ public:
             {
                 if (f < 0)
                 {
-                    s.An00010001();
+                    if (track) s.An00010001();
                     f = -f;
                 }
 
                 if (g < 0)
                 {
-                    s.A1000n0001();
+                    if (track) s.A1000n0001();
                     g = -g;
                 }
 
                 if (h < 0)
                 {
-                    s.A10001000n();
+                    if (track) s.A10001000n();
                     h = -h;
                 }
             }
@@ -669,19 +384,19 @@ public:
 
                 if (s1 == 1)
                 {
-                    s.An00010001();
+                    if (track) s.An00010001();
                     f = -f;
                 }
 
                 if (s2 == 1)
                 {
-                    s.A1000n0001();
+                    if (track) s.A1000n0001();
                     g = -g;
                 }
 
                 if (s3 == 1)
                 {
-                    s.A10001000n();
+                    if (track) s.A10001000n();
                     h = -h;
                 }
             }
@@ -693,7 +408,7 @@ public:
         if (a + b + f + g + h == 0 &&
             a + a + g + g + h > 0)
         {
-            s.An010n1001();
+            if (track) s.An010n1001();
             c += a + b + f + g + h;
             f += h + b + b; f = -f;
             g += h + a + a; g = -g;
@@ -701,7 +416,7 @@ public:
 
         if (a == -h && g != 0)
         {
-            s.Ann00n0001();
+            if (track) s.Ann00n0001();
             f += g; f = -f;
             g = -g;
             h = -h;
@@ -709,7 +424,7 @@ public:
 
         if (a == -g && h != 0)
         {
-            s.An0n01000n();
+            if (track) s.An0n01000n();
             f += h; f = -f;
             h = -h;
             g += (2*a);
@@ -717,7 +432,7 @@ public:
 
         if (b == -f && h != 0)
         {
-            s.A1000nn00n();
+            if (track) s.A1000nn00n();
             g += h; g = -g;
             h = -h;
             f += (2*b);
@@ -725,25 +440,25 @@ public:
 
         if (a == h && g > f + f)
         {
-            s.Ann001000n();
+            if (track) s.Ann001000n();
             f = g - f;
         }
 
         if (a == g && h > f + f)
         {
-            s.An0n0n0001();
+            if (track) s.An0n0n0001();
             f = h - f;
         }
 
         if (b == f && h > g + g)
         {
-            s.An000nn001();
+            if (track) s.An000nn001();
             g = h - g;
         }
 
         if (a == b && abs(f) > abs(g))
         {
-            s.A0n0n0000n();
+            if (track) s.A0n0n0000n();
             R t;
             t = a; a = b; b = t;
             t = g; g = f; f = t;
@@ -751,14 +466,14 @@ public:
 
         if (b == c && abs(g) > abs(h))
         {
-            s.An0000n0n0();
+            if (track) s.An0000n0n0();
             R t;
             t = g; g = h; h = t;
         }
 
         if (a == b && abs(f) > abs(g))
         {
-            s.A0n0n0000n();
+            if (track) s.A0n0n0000n();
             R t;
             t = g; g = f; f = t;
         }
@@ -766,6 +481,24 @@ public:
         return QuadForm<R>(a, b, c, f, g, h);
     }
 
+    // Reduces a block of n forms in place, along with their isometries.
+    static void reduce(QuadForm<R> *q, Isometry<R> *s, size_t n)
+    {
+        for (size_t i=0; i<n; i++)
+        {
+            q[i] = QuadForm<R>::reduce(q[i], s[i]);
+        }
+    }
+
+    // Reduces a block of n forms in place, without their isometries.
+    static void reduce(QuadForm<R> *q, size_t n)
+    {
+        for (size_t i=0; i<n; i++)
+        {
+            q[i] = QuadForm<R>::reduce(q[i]);
+        }
+    }
+
     friend std::ostream& operator<<(std::ostream& os, const QuadForm<R>& q)
     {
         os << "QuadForm(" << q.a_ << "," << q.b_ << "," << q.c_ << ","
@@ -777,20 +510,20 @@ protected:
     R a_, b_, c_, f_, g_, h_;
 };
 
-template<typename R, typename S>
+template<typename R, typename S, typename F>
 class QuadFormFp : public QuadForm<R>
 {
 public:
     QuadFormFp(const R& a, const R& b, const R& c,
                const R& f, const R& g, const R& h,
-               std::shared_ptr<Fp<R,S>> GF) :
+               std::shared_ptr<F> GF) :
         QuadForm<R>(GF->mod(a), GF->mod(b), GF->mod(c),
                     GF->mod(f), GF->mod(g), GF->mod(h))
     {
         this->GF = GF;
     }
 
-    const std::shared_ptr<Fp<R,S>>& field(void) const
+    const std::shared_ptr<F>& field(void) const
     {
         return this->GF;
     }
@@ -907,7 +640,7 @@ public:
     }
 
 private:
-    std::shared_ptr<Fp<R,S>> GF;
+    std::shared_ptr<F> GF;
 
     // To avoid unnecessary computation, we encode each of the three 2-isotropic
     // vectors as a coordinate of the return vector. Special care must be taken
@@ -979,6 +712,12 @@ Vector3<R> operator+(const Vector3<R>& a, const Vector3<R>& b)
     return res;
 }
 
+template<>
+Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q, Z_Isometry& s);
+
+template<>
+Z_QuadForm Z_QuadForm::reduce(const Z_QuadForm& q);
+
 template<>
 Z_QuadForm Z_QuadForm::get_quad_form(const std::vector<Z_PrimeSymbol>& primes);
 
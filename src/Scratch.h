@@ -0,0 +1,22 @@
+#ifndef __SCRATCH_H_
+#define __SCRATCH_H_
+
+#include "birch.h"
+
+// A fixed number of multi-precision temporaries. Declaring an instance as
+// static thread_local at a call site gives every thread its own copy whose
+// limbs persist across calls, so that once the temporaries have grown large
+// enough, no further heap allocation takes place.
+template<size_t N>
+class Scratch
+{
+public:
+    Z& operator[](size_t n) { return this->vars[n]; }
+
+    mpz_ptr ptr(size_t n) { return this->vars[n].get_mpz_t(); }
+
+private:
+    std::array<Z,N> vars;
+};
+
+#endif // __SCRATCH_H_
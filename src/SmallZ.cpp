@@ -0,0 +1,31 @@
+#include "birch.h"
+
+void SmallZ::set(const Z& x)
+{
+    if (mpz_fits_slong_p(x.get_mpz_t()))
+    {
+        delete this->big;
+        this->big = nullptr;
+        this->val = mpz_get_si(x.get_mpz_t());
+    }
+    else if (this->big)
+    {
+        *this->big = x;
+    }
+    else
+    {
+        this->big = new Z(x);
+    }
+}
+
+int SmallZ::cmp_slow(const SmallZ& a, const SmallZ& b)
+{
+    return cmp(a.get_z(), b.get_z());
+}
+
+std::ostream& operator<<(std::ostream& os, const SmallZ& x)
+{
+    if (x.is_small()) os << x.get_si();
+    else os << x.get_z();
+    return os;
+}
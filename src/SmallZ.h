@@ -0,0 +1,241 @@
+#ifndef __SMALL_Z_H_
+#define __SMALL_Z_H_
+
+// An arbitrary precision integer which stores values fitting into 64 bits
+// inline, and only promotes to a heap allocated mpz_class when an operation
+// overflows. Results that fit into 64 bits again are demoted, so that the
+// inline fast path is taken as often as possible.
+//
+// This header is included from birch.h once the integer types are defined.
+
+#include <type_traits>
+#include <utility>
+
+class SmallZ
+{
+public:
+    SmallZ() : val(0), big(nullptr) {}
+
+    template<typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+    SmallZ(I x) : val((Z64)x), big(nullptr)
+    {
+        if (std::is_unsigned<I>::value && (W64)x > (W64)INT64_MAX)
+        {
+            this->big = new Z((W64)x);
+        }
+    }
+
+    explicit SmallZ(const Z& x) : val(0), big(nullptr)
+    {
+        this->set(x);
+    }
+
+    SmallZ(const SmallZ& other) : val(other.val), big(nullptr)
+    {
+        if (unlikely(other.big)) this->big = new Z(*other.big);
+    }
+
+    SmallZ(SmallZ&& other) noexcept : val(other.val), big(other.big)
+    {
+        other.big = nullptr;
+    }
+
+    ~SmallZ()
+    {
+        delete this->big;
+    }
+
+    SmallZ& operator=(const SmallZ& other)
+    {
+        if (likely(!this->big && !other.big))
+        {
+            this->val = other.val;
+        }
+        else if (this != &other)
+        {
+            if (other.big) this->set(*other.big);
+            else
+            {
+                delete this->big;
+                this->big = nullptr;
+                this->val = other.val;
+            }
+        }
+        return *this;
+    }
+
+    SmallZ& operator=(SmallZ&& other) noexcept
+    {
+        std::swap(this->val, other.val);
+        std::swap(this->big, other.big);
+        return *this;
+    }
+
+    bool is_small(void) const { return this->big == nullptr; }
+
+    // The value as a signed 64-bit integer. If the value does not fit, the
+    // result is truncated in the same way as mpz_get_si.
+    Z64 get_si(void) const
+    {
+        return likely(!this->big) ? this->val : mpz_get_si(this->big->get_mpz_t());
+    }
+
+    Z get_z(void) const
+    {
+        return likely(!this->big) ? Z(this->val) : *this->big;
+    }
+
+    friend inline SmallZ operator+(const SmallZ& a, const SmallZ& b)
+    {
+        Z64 r;
+        if (likely(!a.big && !b.big) && !__builtin_add_overflow(a.val, b.val, &r))
+        {
+            return SmallZ(r);
+        }
+        return SmallZ(a.get_z() + b.get_z());
+    }
+
+    friend inline SmallZ operator-(const SmallZ& a, const SmallZ& b)
+    {
+        Z64 r;
+        if (likely(!a.big && !b.big) && !__builtin_sub_overflow(a.val, b.val, &r))
+        {
+            return SmallZ(r);
+        }
+        return SmallZ(a.get_z() - b.get_z());
+    }
+
+    friend inline SmallZ operator*(const SmallZ& a, const SmallZ& b)
+    {
+        Z64 r;
+        if (likely(!a.big && !b.big) && !__builtin_mul_overflow(a.val, b.val, &r))
+        {
+            return SmallZ(r);
+        }
+        return SmallZ(a.get_z() * b.get_z());
+    }
+
+    // Division and remainder truncate toward zero, as with both built-in
+    // integers and mpz_class.
+    friend inline SmallZ operator/(const SmallZ& a, const SmallZ& b)
+    {
+        if (likely(!a.big && !b.big) && !(b.val == -1 && a.val == INT64_MIN))
+        {
+            return SmallZ(a.val / b.val);
+        }
+        return SmallZ(a.get_z() / b.get_z());
+    }
+
+    friend inline SmallZ operator%(const SmallZ& a, const SmallZ& b)
+    {
+        if (likely(!a.big && !b.big))
+        {
+            return (b.val == -1) ? SmallZ(0) : SmallZ(a.val % b.val);
+        }
+        return SmallZ(a.get_z() % b.get_z());
+    }
+
+    // Right shifts round toward negative infinity, as with mpz_class.
+    friend inline SmallZ operator>>(const SmallZ& a, int n)
+    {
+        if (likely(!a.big)) return SmallZ(a.val >> n);
+        return SmallZ(a.get_z() >> n);
+    }
+
+    friend inline SmallZ operator-(const SmallZ& a)
+    {
+        if (likely(!a.big && a.val != INT64_MIN)) return SmallZ(-a.val);
+        return SmallZ(-a.get_z());
+    }
+
+    friend inline SmallZ abs(const SmallZ& a)
+    {
+        if (likely(!a.big && a.val != INT64_MIN))
+        {
+            return SmallZ(a.val < 0 ? -a.val : a.val);
+        }
+        return SmallZ(abs(a.get_z()));
+    }
+
+    SmallZ& operator+=(const SmallZ& b)
+    {
+        Z64 r;
+        if (likely(!this->big && !b.big) && !__builtin_add_overflow(this->val, b.val, &r))
+        {
+            this->val = r;
+            return *this;
+        }
+        return *this = *this + b;
+    }
+
+    SmallZ& operator-=(const SmallZ& b)
+    {
+        Z64 r;
+        if (likely(!this->big && !b.big) && !__builtin_sub_overflow(this->val, b.val, &r))
+        {
+            this->val = r;
+            return *this;
+        }
+        return *this = *this - b;
+    }
+
+    SmallZ& operator*=(const SmallZ& b)
+    {
+        Z64 r;
+        if (likely(!this->big && !b.big) && !__builtin_mul_overflow(this->val, b.val, &r))
+        {
+            this->val = r;
+            return *this;
+        }
+        return *this = *this * b;
+    }
+
+    SmallZ& operator/=(const SmallZ& b)
+    {
+        return *this = *this / b;
+    }
+
+    SmallZ& operator%=(const SmallZ& b)
+    {
+        return *this = *this % b;
+    }
+
+    SmallZ& operator++(void)
+    {
+        return *this += 1;
+    }
+
+    SmallZ& operator--(void)
+    {
+        return *this -= 1;
+    }
+
+    friend inline int cmp(const SmallZ& a, const SmallZ& b)
+    {
+        if (likely(!a.big && !b.big)) return (a.val > b.val) - (a.val < b.val);
+        return SmallZ::cmp_slow(a, b);
+    }
+
+    friend inline bool operator==(const SmallZ& a, const SmallZ& b) { return cmp(a, b) == 0; }
+    friend inline bool operator!=(const SmallZ& a, const SmallZ& b) { return cmp(a, b) != 0; }
+    friend inline bool operator<(const SmallZ& a, const SmallZ& b) { return cmp(a, b) < 0; }
+    friend inline bool operator<=(const SmallZ& a, const SmallZ& b) { return cmp(a, b) <= 0; }
+    friend inline bool operator>(const SmallZ& a, const SmallZ& b) { return cmp(a, b) > 0; }
+    friend inline bool operator>=(const SmallZ& a, const SmallZ& b) { return cmp(a, b) >= 0; }
+
+    friend std::ostream& operator<<(std::ostream& os, const SmallZ& x);
+
+private:
+    // The value whenever big is null.
+    Z64 val;
+
+    // The value whenever it does not fit into 64 bits.
+    Z *big;
+
+    // Assigns an arbitrary precision value, demoting it if it fits.
+    void set(const Z& x);
+
+    static int cmp_slow(const SmallZ& a, const SmallZ& b);
+};
+
+#endif // __SMALL_Z_H_
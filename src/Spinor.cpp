@@ -0,0 +1,91 @@
+#include "birch.h"
+#include "Isometry.h"
+#include "Spinor.h"
+
+template<>
+void Spinor<Z>::init_word_primes(void)
+{
+    std::vector<W64> primes;
+    for (const Z& p : this->primes_)
+    {
+        if (!p.fits_ulong_p()) return;
+        primes.push_back(p.get_ui());
+    }
+    this->set_word_primes(primes);
+}
+
+template<>
+void Spinor<Z64>::init_word_primes(void)
+{
+    std::vector<W64> primes;
+    for (const Z64& p : this->primes_)
+    {
+        primes.push_back(p);
+    }
+    this->set_word_primes(primes);
+}
+
+template<>
+void Spinor<SmallZ>::init_word_primes(void)
+{
+    std::vector<W64> primes;
+    for (const SmallZ& p : this->primes_)
+    {
+        if (!p.is_small()) return;
+        primes.push_back(p.get_si());
+    }
+    this->set_word_primes(primes);
+}
+
+template<>
+Z64 Spinor<Z>::compute_vals(Z x) const
+{
+    if (this->word_primes_.size() == this->primes_.size() && x.fits_slong_p())
+    {
+        Z64 y = x.get_si();
+        return this->word_vals(y < 0 ? -(W64)y : (W64)y);
+    }
+
+    // The value is updated in place, removing all factors of each prime.
+    Z64 val = 0;
+    Z64 mask = 1;
+    for (const Z& p : this->primes_)
+    {
+        if (mpz_remove(x.get_mpz_t(), x.get_mpz_t(), p.get_mpz_t()) & 1)
+        {
+            val ^= mask;
+        }
+        mask <<= 1;
+    }
+    return val;
+}
+
+template<>
+Z64 Spinor<Z64>::compute_vals(Z64 x) const
+{
+    return this->word_vals(x < 0 ? -(W64)x : (W64)x);
+}
+
+template<>
+Z64 Spinor<SmallZ>::compute_vals(SmallZ x) const
+{
+    if (this->word_primes_.size() == this->primes_.size() && x.is_small())
+    {
+        Z64 y = x.get_si();
+        return this->word_vals(y < 0 ? -(W64)y : (W64)y);
+    }
+
+    Z z = x.get_z();
+    Z64 val = 0;
+    Z64 mask = 1;
+    for (const SmallZ& p : this->primes_)
+    {
+        Z q = p.get_z();
+        if (mpz_remove(z.get_mpz_t(), z.get_mpz_t(), q.get_mpz_t()) & 1)
+        {
+            val ^= mask;
+        }
+        mask <<= 1;
+    }
+    return val;
+}
@@ -14,6 +14,7 @@ public:
     {
         this->primes_ = primes;
         this->twist = (1LL << this->primes_.size()) - 1;
+        this->init_word_primes();
     }
 
     Z64 norm(const QuadForm<R>& q, const Isometry<R>& s, const R& scalar) const
@@ -40,15 +41,113 @@ public:
         return this->compute_vals(abh * scalar);
     }
 
+    // Computes the spinor norm of the product s1*s2 without forming it. The
+    // trace of the product decides the norm for almost all isometries, so
+    // the remaining entries are only computed when it does not.
+    Z64 norm(const QuadForm<R>& q, const Isometry<R>& s1,
+             const Isometry<R>& s2, const R& scalar) const
+    {
+        R tr = s1.a11 * s2.a11;
+        tr += s1.a12 * s2.a21;
+        tr += s1.a13 * s2.a31;
+        tr += s1.a21 * s2.a12;
+        tr += s1.a22 * s2.a22;
+        tr += s1.a23 * s2.a32;
+        tr += s1.a31 * s2.a13;
+        tr += s1.a32 * s2.a23;
+        tr += s1.a33 * s2.a33;
+        if (tr != -scalar)
+        {
+            return this->compute_vals(tr + scalar);
+        }
+
+        Isometry<R> s;
+        s.set_product(s1, s2);
+        return this->norm(q, s, scalar);
+    }
+
     const std::vector<R> primes(void) const
     {
         return this->primes_;
     }
 
 private:
+    // The primes together with the data needed to test word-sized values
+    // for divisibility by them without a division: for odd p, x is
+    // divisible by p exactly when x * inv <= bound modulo 2^64, where inv
+    // is the inverse of p modulo 2^64 and bound = (2^64-1)/p, and then
+    // x * inv is the quotient.
+    struct WordPrime {
+        W64 p;
+        W64 inv;
+        W64 bound;
+    };
+
     std::vector<R> primes_;
+    std::vector<WordPrime> word_primes_;
     Z64 twist;
 
+    // Fills word_primes_ if every prime fits into a word; otherwise it is
+    // left empty and valuations are computed with arithmetic over R.
+    void init_word_primes(void)
+    {
+    }
+
+    void set_word_primes(const std::vector<W64>& primes)
+    {
+        this->word_primes_.clear();
+        for (W64 p : primes)
+        {
+            WordPrime wp;
+            wp.p = p;
+            wp.inv = 1;
+            wp.bound = ~(W64)0 / p;
+
+            // Newton iteration doubles the number of correct bits of the
+            // inverse at each step.
+            if (p & 1)
+            {
+                wp.inv = p;
+                for (int k=0; k<5; k++) wp.inv *= 2 - p * wp.inv;
+            }
+
+            this->word_primes_.push_back(wp);
+        }
+    }
+
+    // Computes the parities of the valuations of a nonzero word at all
+    // primes at once, using only multiplications and comparisons.
+    Z64 word_vals(W64 x) const
+    {
+        #ifdef DEBUG
+        assert( x != 0 );
+        #endif
+
+        Z64 val = 0;
+        Z64 mask = 1;
+        for (const WordPrime& wp : this->word_primes_)
+        {
+            if (wp.p == 2)
+            {
+                int v = __builtin_ctzll(x);
+                x >>= v;
+                if (v & 1) val ^= mask;
+            }
+            else
+            {
+                W64 y = x * wp.inv;
+                while (y <= wp.bound)
+                {
+                    x = y;
+                    val ^= mask;
+                    y = x * wp.inv;
+                }
+            }
+            mask <<= 1;
+        }
+        return val;
+    }
+
     Z64 compute_vals(R x) const
     {
         Z64 val = 0;
@@ -66,4 +165,22 @@ private:
     }
 };
 
+template<>
+void Spinor<Z>::init_word_primes(void);
+
+template<>
+void Spinor<Z64>::init_word_primes(void);
+
+template<>
+void Spinor<SmallZ>::init_word_primes(void);
+
+template<>
+Z64 Spinor<Z>::compute_vals(Z x) const;
+
+template<>
+Z64 Spinor<Z64>::compute_vals(Z64 x) const;
+
+template<>
+Z64 Spinor<SmallZ>::compute_vals(SmallZ x) const;
+
 #endif // __SPINOR_H_
@@ -4,8 +4,8 @@
 
 int main(int argc, char **argv)
 {
-    std::vector<Z_PrimeSymbol> symbols;
-    Z_PrimeSymbol p;
+    std::vector<Z64_PrimeSymbol> symbols;
+    Z64_PrimeSymbol p;
 
     p.p = 11;
     p.power = 1;
@@ -32,13 +32,27 @@ int main(int argc, char **argv)
     p.ramified = true;
     symbols.push_back(p);
 
-    Z_Isometry s;
-    Z_QuadForm q = Z_QuadForm::get_quad_form(symbols);
+    Z64_QuadForm q = Z64_QuadForm::get_quad_form(symbols);
 
-    Z_Genus genus1(q, symbols);
-    std::shared_ptr<Z64_Genus> genus2 = std::make_shared<Z64_Genus>(genus1);
+    std::shared_ptr<Z64_Genus> genus2 = std::make_shared<Z64_Genus>(q, symbols);
 
     genus2->hecke_matrix_dense(8191);
 
+    const HashMap<Z64_QuadForm>& reps = genus2->representatives();
+    std::cout << "genus size: " << reps.size() << std::endl;
+    std::cout << "load factor: " << reps.load_factor() << std::endl;
+    std::cout << "mean probe length: " << reps.mean_probe_length() << std::endl;
+    std::cout << "max probe length: " << reps.max_probe_length() << std::endl;
+
+    // Representatives whose full hash values collide.
+    std::vector<W64> hashes;
+    for (const Z64_QuadForm& rep : reps.keys())
+    {
+        hashes.push_back(std::hash<Z64_QuadForm>{}(rep));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    size_t distinct = std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+    std::cout << "hash collisions: " << reps.size() - distinct << std::endl;
+
     return EXIT_SUCCESS;
 }
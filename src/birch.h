@@ -10,6 +10,7 @@
 #include <array>
 #include <random>
 #include <memory>
+#include <mutex>
 #include <gmpxx.h>
 
 /* Type definitions */
@@ -31,6 +32,10 @@ typedef __int128_t Z128;
 #define likely(x)   __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
+/* Small-value optimized arbitrary precision integers */
+
+#include "SmallZ.h"
+
 // Constants
 constexpr W64 FNV_OFFSET = 0x811c9dc5;
 constexpr W64 FNV_PRIME  = 0x01000193;
@@ -46,22 +51,22 @@ class Isometry;
 template<typename R>
 class QuadForm;
 
-template<typename R, typename S>
-class QuadFormFp;
-
 template<typename R, typename S>
 class Fp;
 
 template<typename R, typename S>
 class F2;
 
+template<typename R, typename S, typename F = Fp<R,S>>
+class QuadFormFp;
+
 template<typename R>
 class Eigenvector;
 
 template<typename R>
 class EigenvectorContainer;
 
-template<typename R, typename S, typename T>
+template<typename R, typename S, typename T, typename F = Fp<R,S>>
 class NeighborManager;
 
 template<typename Key>
@@ -79,6 +84,9 @@ class GenusRep;
 template<typename R, typename S, typename T>
 class IsometrySequence;
 
+template<typename R>
+class PrecisionPlanner;
+
 class SetCover;
 
 /* Struct definitions */
@@ -116,10 +124,12 @@ struct PrimeSymbol {
 // Isometries.
 typedef Isometry<Z> Z_Isometry;
 typedef Isometry<Z64> Z64_Isometry;
+typedef Isometry<SmallZ> SmallZ_Isometry;
 
 // Quadratic forms over the integers.
 typedef QuadForm<Z64> Z64_QuadForm;
 typedef QuadForm<Z>   Z_QuadForm;
+typedef QuadForm<SmallZ> SmallZ_QuadForm;
 
 // Quadratic forms over a finite field.
 typedef QuadFormFp<W16,W32>  W16_QuadForm;
@@ -132,6 +142,7 @@ typedef Vector3<W32> W32_Vector3;
 typedef Vector3<W64> W64_Vector3;
 typedef Vector3<Z64> Z64_Vector3;
 typedef Vector3<Z>   Z_Vector3;
+typedef Vector3<SmallZ> SmallZ_Vector3;
 
 // Finite fields.
 typedef Fp<W16,W32>  W16_Fp;
@@ -142,25 +153,36 @@ typedef F2<W16,W32>  W16_F2;
 // Prime symbols
 typedef PrimeSymbol<Z>   Z_PrimeSymbol;
 typedef PrimeSymbol<Z64> Z64_PrimeSymbol;
+typedef PrimeSymbol<SmallZ> SmallZ_PrimeSymbol;
 
 // Math.
 typedef Math<Z> Z_Math;
 typedef Math<Z64> Z64_Math;
+typedef Math<SmallZ> SmallZ_Math;
+typedef Math<W16> W16_Math;
+typedef Math<W32> W32_Math;
+typedef Math<W64> W64_Math;
 
 // Neighbor managers.
 typedef NeighborManager<W16,W32,Z>  Z_W16_NeighborManager;
 typedef NeighborManager<W32,W64,Z>  Z_W32_NeighborManager;
 typedef NeighborManager<W64,W128,Z> Z_W64_NeighborManager;
+typedef NeighborManager<W16,W32,Z,W16_F2> Z_W16_F2_NeighborManager;
 typedef NeighborManager<W16,W32,Z64>  Z64_W16_NeighborManager;
 typedef NeighborManager<W32,W64,Z64>  Z64_W32_NeighborManager;
 typedef NeighborManager<W64,W128,Z64> Z64_W64_NeighborManager;
+typedef NeighborManager<W16,W32,SmallZ>  SmallZ_W16_NeighborManager;
+typedef NeighborManager<W32,W64,SmallZ>  SmallZ_W32_NeighborManager;
+typedef NeighborManager<W64,W128,SmallZ> SmallZ_W64_NeighborManager;
 
 // Genus
 typedef Genus<Z64> Z64_Genus;
 typedef Genus<Z>   Z_Genus;
+typedef Genus<SmallZ> SmallZ_Genus;
 
 // Genus representatives
 typedef GenusRep<Z64> Z64_GenusRep;
 typedef GenusRep<Z> Z_GenusRep;
+typedef GenusRep<SmallZ> SmallZ_GenusRep;
 
 #endif // __BIRCH_H_
@@ -90,6 +90,54 @@ namespace birch_util
         return x;
     }
 
+    template<>
+    W16 convert_Integer<SmallZ>(const SmallZ& x)
+    {
+        return (W16)x.get_si();
+    }
+
+    template<>
+    W32 convert_Integer<SmallZ>(const SmallZ& x)
+    {
+        return (W32)x.get_si();
+    }
+
+    template<>
+    W64 convert_Integer<SmallZ>(const SmallZ& x)
+    {
+        return x.is_small() ? (W64)x.get_si() : (W64)mpz_get_ui(x.get_z().get_mpz_t());
+    }
+
+    template<>
+    Z64 convert_Integer<SmallZ>(const SmallZ& x)
+    {
+        return x.get_si();
+    }
+
+    template<>
+    Z convert_Integer<SmallZ>(const SmallZ& x)
+    {
+        return x.get_z();
+    }
+
+    template<>
+    SmallZ convert_Integer<SmallZ>(const SmallZ& x)
+    {
+        return x;
+    }
+
+    template<>
+    SmallZ convert_Integer<Z64>(const Z64& x)
+    {
+        return SmallZ(x);
+    }
+
+    template<>
+    SmallZ convert_Integer<Z>(const Z& x)
+    {
+        return SmallZ(x);
+    }
+
     int char_vals[256] = {
          1, -1, -1,  1, -1,  1,  1, -1, -1,  1,  1, -1,  1, -1, -1,  1, -1,  1,
          1, -1,  1, -1, -1,  1,  1, -1, -1,  1, -1,  1,  1, -1, -1,  1,  1, -1,
@@ -53,27 +53,9 @@ namespace birch_util
         to.sinv = birch_util::convert_Isometry<From,To>(from.sinv);
         to.parent = from.parent;
         to.p = convert_Integer<From,To>(from.p);
-        for (auto& pair : from.es)
-        {
-            to.es[convert_Integer<From,To>(pair.first)] = pair.second;
-        }
         return to;
     }
 
-    template<typename R>
-    inline R my_pow(const std::map<R,int>& pairs)
-    {
-        R x = 1;
-        for (const auto& pair : pairs)
-        {
-            for (int k=0; k<pair.second; k++)
-            {
-                x *= pair.first;
-            }
-        }
-        return x;
-    }
-
     int popcnt(Z64 x);
 
     extern int char_vals[256];
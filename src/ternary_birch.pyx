@@ -1,5 +1,5 @@
 # distutils: language = c++
-# distutils: sources = birch_util.cpp Fp.cpp Isometry.cpp Math.cpp QuadForm.cpp SetCover.cpp
+# distutils: sources = birch_util.cpp Fp.cpp Isometry.cpp Math.cpp NeighborManager.cpp QuadForm.cpp SetCover.cpp SmallZ.cpp Spinor.cpp
 # distutils: extra_compile_args = -g -Wall -Werror -std=c++11 -fvar-tracking-assignments-toggle
 
 from __future__ import print_function
@@ -50,6 +50,11 @@ cdef extern from "gmpxx.h":
         mpz_class(mpz_t a)
         string get_str(int base)
 
+cdef extern from "birch.h":
+    cdef cppclass SmallZ:
+        SmallZ(const mpz_class& x)
+        mpz_class get_z() const
+
 cdef extern from "QuadForm.h":
     cdef cppclass PrimeSymbol[R]:
         R p
@@ -81,7 +86,7 @@ cdef extern from "Eigenvector.h":
 cdef extern from "Genus.h":
     cdef cppclass Genus[R]:
         Genus()
-        Genus(const QuadForm[R]& q, const vector[PrimeSymbol[R]]& symbols, W64 seed)
+        Genus(const QuadForm[R]& q, const vector[PrimeSymbol[R]]& symbols, W64 seed) except +
         cppmap[R,size_t] dimension_map() const
         W64 seed() const
         cppmap[R,vector[int]] hecke_matrix_dense(const R& p) except +
@@ -93,6 +98,14 @@ cdef extern from "Genus.h":
         @staticmethod
         Genus[T] convert[T](const Genus[R]& src)
 
+cdef extern from "PrecisionPlanner.h":
+    cdef cppclass PrecisionPlanner[R]:
+        PrecisionPlanner(const Genus[R]& genus)
+        size_t genus_bits() const
+        size_t hecke_bits(const R& p) const
+        int hecke_type(const R& p) const
+    cdef int PRECISION_Z64 "PrecisionPlanner<mpz_class>::TYPE_Z64"
+
 cdef extern from "Isometry.h":
     cdef cppclass Isometry[R]:
         R a11
@@ -120,13 +133,19 @@ cdef extern from "IsometrySequence.h":
 ctypedef mpz_class Z
 ctypedef PrimeSymbol[Z] Z_PrimeSymbol
 ctypedef QuadForm[Z] Z_QuadForm
+ctypedef PrimeSymbol[Z64] Z64_PrimeSymbol
+ctypedef QuadForm[Z64] Z64_QuadForm
 
 cdef class BirchGenus:
     cdef shared_ptr[Genus[Z]] Z_genus
+    cdef shared_ptr[Genus[SmallZ]] SmallZ_genus
     cdef shared_ptr[Genus[Z64]] Z64_genus
-    cdef EigenvectorManager[Z] Z_manager
+    cdef shared_ptr[PrecisionPlanner[Z]] Z_planner
+    cdef shared_ptr[PrecisionPlanner[Z64]] Z64_planner
+    cdef EigenvectorManager[SmallZ] SmallZ_manager
     cdef EigenvectorManager[Z64] Z64_manager
     cpdef Z64_genus_is_set
+    cpdef Z_genus_is_set
     cpdef level_
     cpdef ramified_primes_
     cpdef facs
@@ -154,6 +173,8 @@ cdef class BirchGenus:
 
         cdef vector[Z_PrimeSymbol] primes
         cdef Z_PrimeSymbol prime
+        cdef vector[Z64_PrimeSymbol] Z64_primes
+        cdef Z64_PrimeSymbol Z64_prime
         for n,p in enumerate(ps):
             prime.p = Z(Integer(p).value)
             prime.power = int(es[n])
@@ -161,6 +182,12 @@ cdef class BirchGenus:
             primes.push_back(prime)
             logging.info("%s at %s", "Ramified" if prime.ramified else "Unramified", p)
 
+            if p < 2**63:
+                Z64_prime.p = Integer(p)
+                Z64_prime.power = prime.power
+                Z64_prime.ramified = prime.ramified
+                Z64_primes.push_back(Z64_prime)
+
         cdef Z_QuadForm q
         try:
             logging.info("Determining desired quadratic form")
@@ -188,25 +215,60 @@ cdef class BirchGenus:
         except Exception as e:
             raise Exception(e.message)
 
-        seed = seed if seed else 0
-        cdef W64 arg_seed = seed
+        # The seed is fixed here, so that a genus built with fixed precision
+        # matches the one we fall back to if fixed precision does not suffice.
+        cdef W64 arg_seed = seed if seed else randint(1, 2**64-1)
+
+        self.Z64_genus_is_set = False
+        self.Z_genus_is_set = False
 
+        # Build the genus with fixed precision if the genus construction can
+        # be carried out without overflowing, and with arbitrary precision
+        # otherwise.
+        cdef Z64_QuadForm Z64_q
         logging.info("Computing genus representatives...")
         genus_start = datetime.now()
-        self.Z_genus = make_shared[Genus[Z]](q, primes, arg_seed)
+        if Z64_primes.size() == primes.size():
+            try:
+                Z64_q = Z64_QuadForm.get_quad_form(Z64_primes)
+                self.Z64_genus = make_shared[Genus[Z64]](Z64_q, Z64_primes, arg_seed)
+                self.Z64_genus_is_set = True
+            except OverflowError:
+                logging.info("Fixed precision does not suffice, using arbitrary precision")
+        if not self.Z64_genus_is_set:
+            self.Z_genus = make_shared[Genus[Z]](q, primes, arg_seed)
+            self.Z_genus_is_set = True
         genus_stop = datetime.now()
         logging.info("Finished computing genus representatives (time: %s)", genus_stop-genus_start)
-        self.seed_ = deref(self.Z_genus).seed()
+        self.seed_ = arg_seed
         logging.info("Seed = %s (%s)", self.seed_, "provided by user" if seed else "set randomly")
 
-        cdef cppmap[Z,size_t] mymap = deref(self.Z_genus).dimension_map()
-        cdef cppmap[Z,size_t].iterator it = mymap.begin()
+        cdef cppmap[Z,size_t] mymap
+        cdef cppmap[Z,size_t].iterator it
+        cdef cppmap[Z64,size_t] Z64_mymap
+        cdef cppmap[Z64,size_t].iterator Z64_it
         self.dims = dict()
-        while it != mymap.end():
-            self.dims[_Z_to_int(deref(it).first)] = deref(it).second
-            incr(it)
-
-        self.Z64_genus_is_set = False
+        if self.Z_genus_is_set:
+            mymap = deref(self.Z_genus).dimension_map()
+            it = mymap.begin()
+            while it != mymap.end():
+                self.dims[_Z_to_int(deref(it).first)] = deref(it).second
+                incr(it)
+        else:
+            Z64_mymap = deref(self.Z64_genus).dimension_map()
+            Z64_it = Z64_mymap.begin()
+            while Z64_it != Z64_mymap.end():
+                self.dims[Integer(deref(Z64_it).first)] = deref(Z64_it).second
+                incr(Z64_it)
+
+        # Exact computations are carried out with small-value optimized
+        # integers, which only fall back to multi-precision when needed.
+        if self.Z_genus_is_set:
+            self.SmallZ_genus = make_shared[Genus[SmallZ]](deref(self.Z_genus))
+            self.Z_planner = make_shared[PrecisionPlanner[Z]](deref(self.Z_genus))
+        else:
+            self.SmallZ_genus = make_shared[Genus[SmallZ]](deref(self.Z64_genus))
+            self.Z64_planner = make_shared[PrecisionPlanner[Z64]](deref(self.Z64_genus))
 
         self.hecke = dict()
         self.sage_hecke = dict()
@@ -230,6 +292,28 @@ cdef class BirchGenus:
     def ramified_primes(self):
         return self.ramified_primes_
 
+    def required_bits(self, p):
+        if self.Z_genus_is_set:
+            return deref(self.Z_planner).hecke_bits(Z(Integer(p).value))
+        return deref(self.Z64_planner).hecke_bits(Integer(p))
+
+    def _resolve_precise(self, p, precise):
+        # Unless the user has asked for a specific precision, use fixed
+        # precision whenever the planner guarantees it cannot overflow.
+        if precise is not None:
+            return precise
+        if self.Z_genus_is_set:
+            return deref(self.Z_planner).hecke_type(Z(Integer(p).value)) != PRECISION_Z64
+        return deref(self.Z64_planner).hecke_type(Integer(p)) != PRECISION_Z64
+
+    def _set_Z_genus(self):
+        # The genus was built with fixed precision, so it is converted only
+        # when arbitrary precision isometries are requested.
+        if not self.Z_genus_is_set:
+            logging.info("Converting fixed-precision Genus object to arbitrary precision Genus object...")
+            self.Z_genus = make_shared[Genus[Z]](deref(self.Z64_genus))
+            self.Z_genus_is_set = True
+
     def next_good_prime(self, p):
         while True:
             p = next_prime(p)
@@ -237,7 +321,7 @@ cdef class BirchGenus:
                 break
         return p
 
-    def rational_eigenvectors(self, precise=True, sparse=None, force=False):
+    def rational_eigenvectors(self, precise=None, sparse=None, force=False):
         # Do not duplicate work if we've already computed the eigenvectors
         if not force and self.eigenvectors is not None:
             return self.eigenvectors
@@ -381,8 +465,9 @@ cdef class BirchGenus:
 
         self.eigenvectors.append(dict(eigenvector))
 
-    def compute_eigenvalues(self, p, precise=True):
+    def compute_eigenvalues(self, p, precise=None):
         prime = Integer(p)
+        precise = self._resolve_precise(prime, precise)
 
         if not prime.is_prime():
             raise Exception("p is not prime.")
@@ -413,7 +498,7 @@ cdef class BirchGenus:
         # Compute the eigenvalues.
         cdef vector[Z32] aps
         if precise:
-            aps = deref(self.Z_genus).eigenvalues(self.Z_manager, Z(Integer(p).value))
+            aps = deref(self.SmallZ_genus).eigenvalues(self.SmallZ_manager, SmallZ(Z(Integer(p).value)))
         else:
             aps = deref(self.Z64_genus).eigenvalues(self.Z64_manager, Integer(p))
 
@@ -424,7 +509,7 @@ cdef class BirchGenus:
         return [ aps[n] for n in range(aps.size()) ]
 
     def reset_eigenvector_manager(self):
-        cdef EigenvectorManager[Z] _Z_manager
+        cdef EigenvectorManager[SmallZ] _SmallZ_manager
         cdef EigenvectorManager[Z64] _Z64_manager
 
         if not self.Z64_genus_is_set:
@@ -439,15 +524,15 @@ cdef class BirchGenus:
             for n,value in enumerate(vec):
                 data[n] = value
             _Z64_manager.add_eigenvector(deref(self.Z64_genus).eigenvector(data, Integer(cond)))
-            _Z_manager.add_eigenvector(deref(self.Z_genus).eigenvector(data, Z(Integer(cond).value)))
+            _SmallZ_manager.add_eigenvector(deref(self.SmallZ_genus).eigenvector(data, SmallZ(Z(Integer(cond).value))))
 
         _Z64_manager.finalize()
-        _Z_manager.finalize()
+        _SmallZ_manager.finalize()
 
         self.Z64_manager = _Z64_manager
-        self.Z_manager = _Z_manager
+        self.SmallZ_manager = _SmallZ_manager
 
-    def compute_eigenvalues_upto(self, upper, precise=True, force=False):
+    def compute_eigenvalues_upto(self, upper, precise=None, force=False):
         ps = []
         p = 1
         while True:
@@ -457,6 +542,10 @@ cdef class BirchGenus:
             else:
                 break
 
+        # The required precision grows with p, so the largest prime decides.
+        if ps:
+            precise = self._resolve_precise(ps[-1], precise)
+
         # If eigenvectors haven't already been computed, do so now.
         if self.eigenvectors is None:
             self.rational_eigenvectors()
@@ -484,15 +573,16 @@ cdef class BirchGenus:
                 continue
 
             if precise:
-                aps = deref(self.Z_genus).eigenvalues(self.Z_manager, Z(Integer(p).value))
+                aps = deref(self.SmallZ_genus).eigenvalues(self.SmallZ_manager, SmallZ(Z(Integer(p).value)))
             else:
                 aps = deref(self.Z64_genus).eigenvalues(self.Z64_manager, Integer(p))
 
             for n,vec in enumerate(self.eigenvectors):
                 vec['aps'][p] = aps[n]
 
-    def isometry_sequence(self, p, precise=True):
+    def isometry_sequence(self, p, precise=None):
         prime = Integer(p)
+        precise = self._resolve_precise(prime, precise)
 
         if not prime.is_prime():
             raise Exception("p is not prime.")
@@ -538,6 +628,8 @@ cdef class BirchGenus:
             yield retval
 
     def _isometry_sequence_precise(self, Integer p):
+        self._set_Z_genus()
+
         cdef shared_ptr[IsometrySequence[W16,W32,Z]] sequence
         sequence = make_shared[IsometrySequence[W16,W32,Z]](self.Z_genus, Z(p.value))
 
@@ -562,8 +654,9 @@ cdef class BirchGenus:
             retval['dst'] = Integer(data.dst)
             yield retval
 
-    def hecke_matrix(self, p, conductor, sparse=None, precise=True):
+    def hecke_matrix(self, p, conductor, sparse=None, precise=None):
         prime = Integer(p)
+        precise = self._resolve_precise(prime, precise)
 
         if not prime.is_prime():
             raise Exception("p is not prime.")
@@ -615,7 +708,7 @@ cdef class BirchGenus:
         else:
             raise Exception("No Hecke matrix associated to this conductor. How did this happen?")
 
-    def sage_hecke_matrix(self, p, conductor, precise=True, sparse=None):
+    def sage_hecke_matrix(self, p, conductor, precise=None, sparse=None):
         prime = Integer(p)
 
         if prime in self.sage_hecke:
@@ -654,12 +747,12 @@ cdef class BirchGenus:
         return self.sage_hecke[prime][conductor]
 
     def _hecke_matrix_dense_precise(self, Integer p):
-        cdef cppmap[Z,vector[int]] mymap
-        cdef cppmap[Z,vector[int]].iterator it
+        cdef cppmap[SmallZ,vector[int]] mymap
+        cdef cppmap[SmallZ,vector[int]].iterator it
 
         try:
             start_time = datetime.now()
-            mymap = deref(self.Z_genus).hecke_matrix_dense(Z(p.value))
+            mymap = deref(self.SmallZ_genus).hecke_matrix_dense(SmallZ(Z(p.value)))
             end_time = datetime.now()
             logging.info("  call time: %s", end_time-start_time)
             self.hecke[p] = dict()
@@ -669,7 +762,7 @@ cdef class BirchGenus:
         start_time = datetime.now()
         it = mymap.begin()
         while it != mymap.end():
-            cond = _Z_to_int(deref(it).first)
+            cond = _Z_to_int(deref(it).first.get_z())
             self.hecke[p][cond] = _make_matrix(self.dims[cond], deref(it).second)
             incr(it)
 
@@ -700,12 +793,12 @@ cdef class BirchGenus:
         logging.info("  copy time: %s", end_time-start_time)
 
     def _hecke_matrix_sparse_precise(self, Integer p):
-        cdef cppmap[Z,vector[vector[int]]] mymap
-        cdef cppmap[Z,vector[vector[int]]].iterator it
+        cdef cppmap[SmallZ,vector[vector[int]]] mymap
+        cdef cppmap[SmallZ,vector[vector[int]]].iterator it
 
         try:
             start_time = datetime.now()
-            mymap = deref(self.Z_genus).hecke_matrix_sparse(Z(p.value))
+            mymap = deref(self.SmallZ_genus).hecke_matrix_sparse(SmallZ(Z(p.value)))
             end_time = datetime.now()
             logging.info("  call time: %s", end_time-start_time)
             self.hecke[p] = dict()
@@ -719,7 +812,7 @@ cdef class BirchGenus:
         start_time = datetime.now()
         it = mymap.begin()
         while it != mymap.end():
-            cond = _Z_to_int(deref(it).first)
+            cond = _Z_to_int(deref(it).first.get_z())
             dim = self.dims[cond]
 
             mat = csr_matrix((np.array([]), np.array([]), np.zeros(dim+1)), shape=(dim,dim))